@@ -0,0 +1,277 @@
+/*Copyright (c) 2025 DannyBimma. All Rights Reserved.
+ *
+ * Build-time generator that turns scoring_rules.def into
+ * one specialised scoring kernel per (track type, condition,
+ * weather band) combination plus a dispatch table.
+ *
+ * */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE_LENGTH 256
+#define MAX_RULES 64
+#define NUM_TRACK_TYPES 3
+#define NUM_TEMPERATURE_BANDS 3
+#define SUCCESS 0
+
+typedef enum {
+  BAND_RAIN,
+  BAND_HOT,
+  BAND_COLD,
+  BAND_WINDY,
+  BAND_HUMID,
+  NUM_BANDS
+} Band;
+
+typedef struct {
+  char guard[MAX_LINE_LENGTH];
+  char expression[MAX_LINE_LENGTH];
+} Rule;
+
+// One point in the kernel space; temperature is 0=mild, 1=hot, 2=cold
+typedef struct {
+  int trackType;
+  bool wet;
+  bool rain;
+  int temperature;
+  bool windy;
+  bool humid;
+} Scenario;
+
+static const char *bandNames[NUM_BANDS] = {"rain", "hot", "cold", "windy",
+                                           "humid"};
+static const char *trackTypeNames[NUM_TRACK_TYPES] = {"Street", "HighSpeed",
+                                                      "Technical"};
+static const char *temperatureNames[NUM_TEMPERATURE_BANDS] = {"", "Hot",
+                                                              "Cold"};
+
+int loadRules(const char *filename, Rule rules[], int *ruleCount,
+              char bands[][MAX_LINE_LENGTH]);
+bool isKnownGuard(const char *guard);
+bool guardApplies(const char *guard, const Scenario *scenario);
+void getKernelName(const Scenario *scenario, char *name, size_t size);
+void emitKernels(const Rule rules[], int ruleCount,
+                 char bands[][MAX_LINE_LENGTH]);
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: ./gen_scoring_kernels [rules file]\n");
+
+    return 1;
+  }
+
+  Rule rules[MAX_RULES];
+  int ruleCount = 0;
+  char bands[NUM_BANDS][MAX_LINE_LENGTH];
+
+  if (loadRules(argv[1], rules, &ruleCount, bands) != SUCCESS) {
+    return 1;
+  }
+
+  emitKernels(rules, ruleCount, bands);
+
+  return 0;
+}
+
+int loadRules(const char *filename, Rule rules[], int *ruleCount,
+              char bands[][MAX_LINE_LENGTH]) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    fprintf(stderr, "Failed to open rules file %s\n", filename);
+
+    return -1;
+  }
+
+  bool bandSeen[NUM_BANDS] = {false};
+  char line[MAX_LINE_LENGTH];
+  int lineNumber = 0;
+  int status = SUCCESS;
+
+  while (status == SUCCESS && fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    line[strcspn(line, "#\r\n")] = '\0';
+
+    char keyword[MAX_LINE_LENGTH];
+    int consumed = 0;
+    if (sscanf(line, "%255s %n", keyword, &consumed) != 1) {
+      continue;
+    }
+
+    const char *rest = line + consumed;
+
+    if (strcmp(keyword, "band") == 0) {
+      char name[MAX_LINE_LENGTH];
+      int nameLength = 0;
+      int band = NUM_BANDS;
+
+      if (sscanf(rest, "%255s %n", name, &nameLength) == 1) {
+        for (band = 0; band < NUM_BANDS; band++) {
+          if (strcmp(name, bandNames[band]) == 0)
+            break;
+        }
+      }
+
+      if (band == NUM_BANDS || strlen(rest + nameLength) == 0) {
+        fprintf(stderr, "%s:%d: expected 'band <%s|%s|%s|%s|%s> <condition>'\n",
+                filename, lineNumber, bandNames[0], bandNames[1], bandNames[2],
+                bandNames[3], bandNames[4]);
+        status = -1;
+        continue;
+      }
+
+      strcpy(bands[band], rest + nameLength);
+      bandSeen[band] = true;
+    } else if (isKnownGuard(keyword) && strlen(rest) > 0) {
+      if (*ruleCount >= MAX_RULES) {
+        fprintf(stderr, "%s:%d: too many rules\n", filename, lineNumber);
+        status = -1;
+        continue;
+      }
+
+      strcpy(rules[*ruleCount].guard, keyword);
+      strcpy(rules[*ruleCount].expression, rest);
+      (*ruleCount)++;
+    } else {
+      fprintf(stderr, "%s:%d: unknown guard '%s' or missing expression\n",
+              filename, lineNumber, keyword);
+      status = -1;
+    }
+  }
+
+  fclose(file);
+
+  for (int band = 0; status == SUCCESS && band < NUM_BANDS; band++) {
+    if (!bandSeen[band]) {
+      fprintf(stderr, "%s: missing band '%s'\n", filename, bandNames[band]);
+      status = -1;
+    }
+  }
+
+  return status;
+}
+
+bool isKnownGuard(const char *guard) {
+  static const char *guards[] = {"always", "street", "highspeed", "technical",
+                                 "wet",    "dry",    "rain",      "hot",
+                                 "cold",   "mild",   "windy",     "humid"};
+
+  for (size_t i = 0; i < sizeof(guards) / sizeof(guards[0]); i++) {
+    if (strcmp(guard, guards[i]) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool guardApplies(const char *guard, const Scenario *scenario) {
+  if (strcmp(guard, "always") == 0) return true;
+  if (strcmp(guard, "street") == 0) return scenario->trackType == 1;
+  if (strcmp(guard, "highspeed") == 0) return scenario->trackType == 2;
+  if (strcmp(guard, "technical") == 0) return scenario->trackType == 3;
+  if (strcmp(guard, "wet") == 0) return scenario->wet;
+  if (strcmp(guard, "dry") == 0) return !scenario->wet;
+  if (strcmp(guard, "rain") == 0) return scenario->rain;
+  if (strcmp(guard, "hot") == 0) return scenario->temperature == 1;
+  if (strcmp(guard, "cold") == 0) return scenario->temperature == 2;
+  if (strcmp(guard, "mild") == 0) return scenario->temperature == 0;
+  if (strcmp(guard, "windy") == 0) return scenario->windy;
+  if (strcmp(guard, "humid") == 0) return scenario->humid;
+
+  return false;
+}
+
+void getKernelName(const Scenario *scenario, char *name, size_t size) {
+  snprintf(name, size, "scoreKernel%s%s%s%s%s%s",
+           trackTypeNames[scenario->trackType - 1],
+           scenario->wet ? "Wet" : "Dry", scenario->rain ? "Rain" : "",
+           temperatureNames[scenario->temperature],
+           scenario->windy ? "Windy" : "", scenario->humid ? "Humid" : "");
+}
+
+void emitKernels(const Rule rules[], int ruleCount,
+                 char bands[][MAX_LINE_LENGTH]) {
+  printf("/* Generated by gen_scoring_kernels from scoring_rules.def. "
+         "Do not edit. */\n\n");
+  printf("#include \"scoring_kernels.h\"\n\n");
+
+  Scenario scenario;
+  char name[MAX_LINE_LENGTH];
+
+  // Kernels, in the same nesting order as the dispatch table below
+  for (scenario.trackType = 1; scenario.trackType <= NUM_TRACK_TYPES;
+       scenario.trackType++)
+    for (int wet = 0; wet < 2; wet++)
+      for (int rain = 0; rain < 2; rain++)
+        for (scenario.temperature = 0;
+             scenario.temperature < NUM_TEMPERATURE_BANDS;
+             scenario.temperature++)
+          for (int windy = 0; windy < 2; windy++)
+            for (int humid = 0; humid < 2; humid++) {
+              scenario.wet = wet;
+              scenario.rain = rain;
+              scenario.windy = windy;
+              scenario.humid = humid;
+              getKernelName(&scenario, name, sizeof(name));
+
+              printf("static void %s(const ScoringDriver drivers[], "
+                     "int driverCount,\n", name);
+              printf("    int drs, int rainProbability, int points[]) {\n");
+              printf("  (void)drs;\n  (void)rainProbability;\n\n");
+              printf("  for (int i = 0; i < driverCount; i++) {\n");
+              printf("    const ScoringDriver *d = &drivers[i];\n\n");
+              printf("    points[i] = 0");
+
+              for (int rule = 0; rule < ruleCount; rule++) {
+                if (guardApplies(rules[rule].guard, &scenario)) {
+                  printf("\n        + (%s)", rules[rule].expression);
+                }
+              }
+
+              printf(";\n  }\n}\n\n");
+            }
+
+  printf("static const ScoringKernel scoringKernels[%d][2][2][%d][2][2] = {\n",
+         NUM_TRACK_TYPES, NUM_TEMPERATURE_BANDS);
+
+  for (scenario.trackType = 1; scenario.trackType <= NUM_TRACK_TYPES;
+       scenario.trackType++)
+    for (int wet = 0; wet < 2; wet++)
+      for (int rain = 0; rain < 2; rain++)
+        for (scenario.temperature = 0;
+             scenario.temperature < NUM_TEMPERATURE_BANDS;
+             scenario.temperature++)
+          for (int windy = 0; windy < 2; windy++)
+            for (int humid = 0; humid < 2; humid++) {
+              scenario.wet = wet;
+              scenario.rain = rain;
+              scenario.windy = windy;
+              scenario.humid = humid;
+              getKernelName(&scenario, name, sizeof(name));
+
+              printf("    [%d][%d][%d][%d][%d][%d] = %s,\n",
+                     scenario.trackType - 1, wet, rain, scenario.temperature,
+                     windy, humid, name);
+            }
+
+  printf("};\n\n");
+
+  printf("ScoringKernel selectScoringKernel(int trackType, bool wet, "
+         "bool hasWeather,\n");
+  printf("                                  int rainProbability, "
+         "float temperature,\n");
+  printf("                                  float windSpeed, "
+         "float humidity) {\n");
+  printf("  int track = trackType >= 1 && trackType <= %d ? trackType - 1 "
+         ": %d;\n", NUM_TRACK_TYPES, NUM_TRACK_TYPES - 1);
+  printf("  int rain = hasWeather && (%s);\n", bands[BAND_RAIN]);
+  printf("  int heat = !hasWeather ? 0 : (%s) ? 1 : (%s) ? 2 : 0;\n",
+         bands[BAND_HOT], bands[BAND_COLD]);
+  printf("  int windy = hasWeather && (%s);\n", bands[BAND_WINDY]);
+  printf("  int humid = hasWeather && (%s);\n\n", bands[BAND_HUMID]);
+  printf("  return scoringKernels[track][wet][rain][heat][windy][humid];\n");
+  printf("}\n");
+}
@@ -6,15 +6,29 @@
  *
  * */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <ctype.h>
 #include <curl/curl.h>
+#include <errno.h>
 #include <jansson.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "result_ring.h"
+#include "scoring_kernels.h"
 
 #define MAX_DRIVERS 20
 #define MAX_STRING_LENGTH 50
@@ -26,6 +40,31 @@
 #define CONFIG_FILE "f1_config.json"
 #define WEATHER_API_KEY ""
 #define WEATHER_API_BASE_URL "http://api.openweathermap.org/data/2.5/weather"
+#define WEATHER_RECORDING_FILE "weather_recording.tsv"
+#define WEATHER_DEFAULT_TIMEOUT_MS 10000
+#define WEATHER_DEFAULT_RETRY_DELAY_MS 250
+#define PREDICTION_LOG_MAGIC 0x474F4C50u   // "PLOG"
+#define PREDICTION_BLOCK_MAGIC 0x4B4C4250u // "PBLK"
+#define PREDICTION_LOG_VERSION 1
+#define PREDICTION_LOG_BLOCK_ROWS 4096
+#define MAX_DRIVER_NUMBER 100
+#define CLIMATOLOGY_FILE "f1_climatology.json"
+#define CLIMATE_QUANTILE_BITS 4
+#define CLIMATE_QUANTILES ((1 << CLIMATE_QUANTILE_BITS) + 1)
+#define CLIMATE_INTERVALS (1 << CLIMATE_QUANTILE_BITS)
+#define CLIMATE_UNIFORM_BITS 12
+#define CLIMATE_SAMPLE_LANES 256
+#define MAX_CLIMATE_REGIMES 8
+#define MAX_CLIMATE_TRACKS 64
+#define MAX_CLIMATE_ALIASES 4
+#define CLIMATE_SAMPLE_BATCH 4096
+#define SCORE_SKETCH_SUB_BUCKET_BITS 6
+#define SCORE_SKETCH_MAX_BITS 31 // any int, e.g. latencies in ns up to 2s
+#define SCORE_SKETCH_MAX_VALUE ((1u << SCORE_SKETCH_MAX_BITS) - 1)
+#define SCORE_SKETCH_BUCKETS                                                   \
+  ((SCORE_SKETCH_MAX_BITS - SCORE_SKETCH_SUB_BUCKET_BITS + 1)                  \
+   << SCORE_SKETCH_SUB_BUCKET_BITS)
+#define MAX_SIM_THREADS 64
 
 typedef struct {
   char name[MAX_STRING_LENGTH];
@@ -88,6 +127,232 @@ typedef struct {
   size_t size;
 } HTTPResponse;
 
+typedef enum {
+  SESSION_PRACTICE,
+  SESSION_QUALIFYING,
+  SESSION_SPRINT,
+  SESSION_RACE,
+  NUM_SESSIONS
+} SessionType;
+
+// Cached output of one weekend session, keyed on a hash of everything it
+// was computed from (its own weather plus the key of the stage feeding it)
+typedef struct {
+  uint64_t key;
+  bool valid;
+  int points[MAX_DRIVERS];
+  int positions[MAX_DRIVERS];
+} StageResult;
+
+typedef struct {
+  Driver drivers[MAX_DRIVERS];
+  int driverCount;
+  char track[MAX_STRING_LENGTH];
+  char condition[MAX_STRING_LENGTH];
+  ScoringDriver scoring[MAX_DRIVERS];
+  int trackType;
+  int drsEffectiveness;
+  uint64_t baseKey;
+  WeatherData weather[NUM_SESSIONS];
+  StageResult stages[NUM_SESSIONS];
+  int stageRuns[NUM_SESSIONS];
+  int stageHits[NUM_SESSIONS];
+} WeekendPipeline;
+
+// Prediction log layout: a file header followed by self-describing blocks.
+// Each block is a header (with min/max indexes used to skip it) and then
+// one contiguous array per column, per-driver score and rank columns last.
+typedef enum {
+  COLUMN_TIMESTAMP,
+  COLUMN_TRACK_ID,
+  COLUMN_TEMPERATURE,
+  COLUMN_HUMIDITY,
+  COLUMN_WIND_SPEED,
+  COLUMN_RAIN_PROBABILITY,
+  COLUMN_SCORE,
+  COLUMN_RANK,
+  COLUMN_END
+} PredictionColumn;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t reserved;
+} PredictionLogFileHeader;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t rowCount;
+  uint32_t driverCount;
+  uint32_t reserved;
+  uint64_t rosterHash;
+  uint64_t blockBytes;
+  int64_t minTimestamp;
+  int64_t maxTimestamp;
+  uint32_t minTrackId;
+  uint32_t maxTrackId;
+  int32_t minRainProbability;
+  int32_t maxRainProbability;
+  float minTemperature;
+  float maxTemperature;
+  int32_t driverNumbers[MAX_DRIVERS];
+} PredictionLogBlockHeader;
+
+// Rows buffered column by column until a block is full
+typedef struct {
+  FILE *file;
+  size_t end; // just past the last complete block this process has seen
+  uint32_t rowCount;
+  int driverCount;
+  uint64_t rosterHash;
+  int32_t driverNumbers[MAX_DRIVERS];
+  int64_t timestamps[PREDICTION_LOG_BLOCK_ROWS];
+  uint32_t trackIds[PREDICTION_LOG_BLOCK_ROWS];
+  float temperatures[PREDICTION_LOG_BLOCK_ROWS];
+  float humidities[PREDICTION_LOG_BLOCK_ROWS];
+  float windSpeeds[PREDICTION_LOG_BLOCK_ROWS];
+  int32_t rainProbabilities[PREDICTION_LOG_BLOCK_ROWS];
+  int32_t scores[MAX_DRIVERS][PREDICTION_LOG_BLOCK_ROWS];
+  uint8_t ranks[MAX_DRIVERS][PREDICTION_LOG_BLOCK_ROWS];
+} PredictionLog;
+
+typedef struct {
+  uint32_t trackId;
+  int64_t from;
+  int64_t to;
+  int actualPositions[MAX_DRIVER_NUMBER];
+} BacktestQuery;
+
+typedef struct {
+  uint64_t blocksScanned;
+  uint64_t blocksSkipped;
+  uint64_t rowsRead;
+  uint64_t predictions;
+  uint64_t winnerHits;
+  uint64_t podiumHits;
+  uint64_t positionError;
+  uint64_t positionsCompared;
+} BacktestStats;
+
+typedef enum {
+  CLIMATE_TEMPERATURE,
+  CLIMATE_HUMIDITY,
+  CLIMATE_WIND_SPEED,
+  CLIMATE_RAIN_PROBABILITY,
+  NUM_CLIMATE_VARIABLES
+} ClimateVariable;
+
+// A circuit's weather as a mixture of regimes (e.g. dry heat vs. passing
+// storm), which is what carries the correlation between variables. The
+// regime is drawn from its cumulative thresholds, then each variable from
+// that regime's inverse-CDF table, stored as a base and slope per interval
+// laid out [variable][regime][interval].
+typedef struct {
+  char names[MAX_CLIMATE_ALIASES + 1][MAX_STRING_LENGTH];
+  int nameCount;
+  int regimeCount;
+  char descriptions[MAX_CLIMATE_REGIMES][MAX_STRING_LENGTH];
+  int32_t regimeThreshold[MAX_CLIMATE_REGIMES]; // P(regime <= r) * 2^12
+  float intervalBase[NUM_CLIMATE_VARIABLES]
+                    [MAX_CLIMATE_REGIMES * CLIMATE_INTERVALS];
+  float intervalSlope[NUM_CLIMATE_VARIABLES]
+                     [MAX_CLIMATE_REGIMES * CLIMATE_INTERVALS];
+} TrackClimate;
+
+typedef struct {
+  int trackCount;
+  TrackClimate tracks[MAX_CLIMATE_TRACKS];
+} Climatology;
+
+// Fixed-size, mergeable accumulators for many-sample runs: memory stays the
+// same whether a driver is sampled a hundred times or 10^8 times
+typedef struct {
+  uint64_t counts[SCORE_SKETCH_BUCKETS];
+  uint64_t total;
+} ScoreSketch;
+
+typedef struct {
+  uint64_t count;
+  double mean;
+  double m2;
+} RunningMoments;
+
+typedef struct {
+  uint64_t positions[MAX_DRIVERS + 1];
+  RunningMoments points;
+  ScoreSketch pointsSketch;
+  ScoreSketch gapSketch;
+} DriverSimStats;
+
+typedef struct {
+  uint64_t samples;
+  int driverCount;
+  DriverSimStats drivers[MAX_DRIVERS];
+} SimStats;
+
+typedef struct {
+  WeekendPipeline pipeline;
+  const TrackClimate *climate;
+  uint64_t seed;
+  PredictionLog *log;
+  ResultRing *ring;
+  long firstRun;
+  long lastRun;
+  SimStats stats;
+} WeekendWorker;
+
+// Order-statistic treap over driver slots, ordered by points (high to low)
+// and then slot. Subtree sizes give a driver's rank, or the driver at a
+// rank, in O(log n).
+typedef struct {
+  int left[MAX_DRIVERS];
+  int right[MAX_DRIVERS];
+  int size[MAX_DRIVERS];
+  uint32_t priority[MAX_DRIVERS];
+  int root;
+} RankTree;
+
+typedef struct {
+  int slot;
+  int from;
+  int to;
+} RankChange;
+
+typedef struct {
+  Driver drivers[MAX_DRIVERS];
+  int driverCount;
+  char condition[MAX_STRING_LENGTH];
+  ScoringDriver scoring[MAX_DRIVERS];
+  int penalties[MAX_DRIVERS];
+  int points[MAX_DRIVERS];
+  int ranks[MAX_DRIVERS]; // last rank reported for each driver
+  int trackType;
+  int drsEffectiveness;
+  WeatherData weather;
+  ScoringKernel kernel;
+  RankTree tree;
+} LiveSession;
+
+// Weather source vtable. fetchBody is optional and only implemented by
+// providers that speak raw OpenWeatherMap JSON, which is what the recording
+// proxy captures.
+typedef struct WeatherProvider WeatherProvider;
+struct WeatherProvider {
+  const char *name;
+  WeatherData *(*fetch)(WeatherProvider *provider, const char *location);
+  char *(*fetchBody)(WeatherProvider *provider, const char *location);
+  WeatherProvider *inner;
+  bool noFallback; // a miss is an error rather than simulated weather
+  bool perDraw;    // every fetch is a fresh draw, not the same observation
+  char baseUrl[MAX_URL_LENGTH];
+  char apiKey[MAX_URL_LENGTH];
+  char filePath[MAX_URL_LENGTH];
+  long timeoutMs;
+  int retries;
+  long retryDelayMs;
+  int attempts;
+};
+
 int initTeamsAndDrivers(Team teams[], Driver drivers[], int *driverCount,
                         const F1Configuration *config);
 void calcPoints(Driver drivers[], int driverCount, const char *track,
@@ -98,18 +363,133 @@ void calcPercentages(Driver drivers[], int driverCount);
 void predictPositions(Driver drivers[], int driverCount);
 void printResults(Driver drivers[], int driverCount, const char *track,
                   const char *condition);
+uint64_t hashBytes(uint64_t hash, const void *data, size_t size);
+uint64_t hashWeather(uint64_t hash, const WeatherData *weather);
+void initWeekendPipeline(WeekendPipeline *pipeline, const Driver drivers[],
+                         int driverCount, const char *track,
+                         const char *condition);
+const char *getSessionCondition(const WeekendPipeline *pipeline,
+                                SessionType session);
+uint64_t getStageKey(const WeekendPipeline *pipeline, SessionType session);
+void runStage(WeekendPipeline *pipeline, SessionType session);
+void runWeekendPipeline(WeekendPipeline *pipeline);
+void printWeekendResults(const WeekendPipeline *pipeline);
+int runWeekendMode(int argc, char *argv[], const F1Configuration *config);
+uint32_t getTrackId(const char *track);
+size_t getPredictionColumnOffset(PredictionColumn column, uint32_t rowCount,
+                                 uint32_t driverCount, int driverSlot);
+bool isPredictionBlockComplete(const PredictionLogBlockHeader *block,
+                               size_t available);
+int lockPredictionLog(int fd, short type);
+size_t findPredictionLogEnd(int fd, size_t start, size_t fileSize);
+int cutPredictionLogTail(int fd, size_t end, size_t fileSize);
+PredictionLog *openPredictionLog(const char *path);
+PredictionLog *openPredictionLogFromEnv(void);
+int flushPredictionLog(PredictionLog *log);
+int appendPrediction(PredictionLog *log, const char *track,
+                     const WeatherData *weather, const Driver drivers[],
+                     const int points[], const int positions[],
+                     int driverCount);
+void closePredictionLog(PredictionLog *log);
+ResultRing *openResultRingFromEnv(void);
+void publishPrediction(ResultRing *ring, const char *track,
+                       const char *condition, const WeatherData *weather,
+                       const Driver drivers[], const int points[],
+                       const int positions[], int driverCount);
+int runBacktestMode(int argc, char *argv[]);
+void scanPredictionLog(const unsigned char *data, size_t fileSize,
+                       const BacktestQuery *query, BacktestStats *stats);
 bool isStringInArray(const char *str, const char *array[], int size);
 void toLowercase(char *str);
 void usageInstructions(void);
 F1Configuration *loadF1ConfigFromFile(const char *filename);
 void freeF1Config(F1Configuration *config);
-WeatherData *getWeatherData(const char *location);
+WeatherProvider *createWeatherProvider(const char *kind);
+void freeWeatherProvider(WeatherProvider *provider);
+WeatherData *getWeatherData(WeatherProvider *provider, const char *location);
+WeatherData *fetchLiveWeather(WeatherProvider *provider, const char *location);
+char *fetchLiveWeatherBody(WeatherProvider *provider, const char *location);
+WeatherData *fetchRecordingWeather(WeatherProvider *provider,
+                                   const char *location);
+WeatherData *fetchReplayWeather(WeatherProvider *provider,
+                                const char *location);
+char *fetchReplayWeatherBody(WeatherProvider *provider, const char *location);
+WeatherData *fetchSimulatedWeather(WeatherProvider *provider,
+                                   const char *location);
 WeatherData *getSimulatedWeatherData(const char *location);
 WeatherData *parseWeatherResponse(const char *jsonResponse);
 void freeWeatherData(WeatherData *weather);
 size_t writeMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp);
 int getDRSEffectiveness(const char *track);
 int getTrackType(const char *track); // 1=street, 2=high-speed, 3=technical
+int loadClimateQuantiles(json_t *values, float base[], float slope[]);
+void buildClimateRegimeTable(TrackClimate *climate, const double weights[]);
+Climatology *loadClimatologyFromFile(const char *filename);
+void freeClimatology(Climatology *climatology);
+const Climatology *getClimatology(void);
+const TrackClimate *findTrackClimate(const Climatology *climatology,
+                                     const char *location);
+uint64_t mixBits(uint64_t x);
+uint32_t hashClimateCounter(uint32_t x);
+int32_t getClimateRegime(const TrackClimate *climate, uint32_t bits);
+float lookupClimateQuantile(const float base[], const float slope[],
+                            int32_t regime, uint32_t bits);
+void sampleClimateBlock(const TrackClimate *climate, uint64_t key,
+                        uint32_t counter, float *restrict temperature,
+                        float *restrict humidity, float *restrict windSpeed,
+                        float *restrict rainProbability,
+                        int *restrict regimes);
+void sampleTrackClimate(const TrackClimate *climate, uint64_t seed,
+                        uint64_t first, size_t count, float temperature[],
+                        float humidity[], float windSpeed[],
+                        float rainProbability[], int regimes[]);
+void sampleClimateWeather(const TrackClimate *climate, uint64_t seed,
+                          uint64_t index, WeatherData *weather);
+uint64_t getWeatherSeed(void);
+int runSampleWeatherMode(int argc, char *argv[]);
+int getScoreSketchIndex(int value);
+double getScoreSketchValue(int index);
+double getScoreSketchLowerBound(int index);
+void addScoreSketch(ScoreSketch *sketch, int value);
+void mergeScoreSketch(ScoreSketch *into, const ScoreSketch *from);
+int getScoreSketchQuantileIndex(const ScoreSketch *sketch, double quantile);
+double getScoreSketchQuantile(const ScoreSketch *sketch, double quantile);
+void addRunningMoments(RunningMoments *moments, double value);
+void mergeRunningMoments(RunningMoments *into, const RunningMoments *from);
+double getRunningStdDev(const RunningMoments *moments);
+void recordSimulationSample(SimStats *stats, const int points[],
+                            const int positions[], int driverCount);
+void mergeSimStats(SimStats *into, const SimStats *from);
+int getMedianPosition(const DriverSimStats *driver, uint64_t samples);
+void printSimStats(const SimStats *stats, const Driver drivers[]);
+void *runWeekendWorker(void *arg);
+void prepareScoringDrivers(const Driver drivers[], int driverCount,
+                           const char *track, ScoringDriver scoring[]);
+ScoringKernel selectKernelForScenario(int trackType, const char *condition,
+                                      const WeatherData *weather);
+void calcKernelPoints(Driver drivers[], int driverCount, const char *track,
+                      const char *condition, WeatherData *weather);
+int runVerifyKernelsMode(const F1Configuration *config);
+bool ranksAhead(const LiveSession *session, int a, int b);
+int getRankTreeSize(const RankTree *tree, int node);
+void updateRankNode(RankTree *tree, int node);
+void splitRankTree(const LiveSession *session, RankTree *tree, int node,
+                   int pivot, int *ahead, int *behind);
+int mergeRankTree(RankTree *tree, int ahead, int behind);
+int insertRankNode(LiveSession *session, int node, int slot);
+int eraseRankNode(LiveSession *session, int node, int slot);
+int getDriverRank(const LiveSession *session, int slot);
+int selectRankedDriver(const LiveSession *session, int rank);
+void selectLiveKernel(LiveSession *session);
+void rescoreLiveDriver(LiveSession *session, int slot);
+int rescoreLiveDrivers(LiveSession *session, const int affected[],
+                       int affectedCount, RankChange changes[]);
+int parseLiveUpdate(LiveSession *session, char *line, int affected[],
+                    int *affectedCount);
+int runLiveMode(int argc, char *argv[], const F1Configuration *config);
+long getEnvLong(const char *name, long fallback);
+double elapsedMs(const struct timespec *start);
+void sleepMs(long ms);
 
 int main(int argc, char *argv[]) {
   Team teams[NUM_TEAMS];
@@ -134,6 +514,46 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  if (strcmp(argv[1], "--backtest") == 0) {
+    int status = runBacktestMode(argc, argv);
+
+    freeF1Config(config);
+
+    return status;
+  }
+
+  if (strcmp(argv[1], "--sample-weather") == 0) {
+    int status = runSampleWeatherMode(argc, argv);
+
+    freeF1Config(config);
+
+    return status;
+  }
+
+  if (strcmp(argv[1], "--verify-kernels") == 0) {
+    int status = runVerifyKernelsMode(config);
+
+    freeF1Config(config);
+
+    return status;
+  }
+
+  if (strcmp(argv[1], "--live") == 0) {
+    int status = runLiveMode(argc, argv, config);
+
+    freeF1Config(config);
+
+    return status;
+  }
+
+  if (strcmp(argv[1], "--weekend") == 0) {
+    int status = runWeekendMode(argc, argv, config);
+
+    freeF1Config(config);
+
+    return status;
+  }
+
   if (argc > 3) {
     printf("Error: Incorrect usage! Too many arguments provided!\n");
     usageInstructions();
@@ -178,12 +598,26 @@ int main(int argc, char *argv[]) {
 
   WeatherData *weather = NULL;
   if (strlen(track) > 0) {
-    weather = getWeatherData(track);
+    WeatherProvider *provider =
+        createWeatherProvider(getenv("F1_WEATHER_PROVIDER"));
+    if (!provider) {
+      freeF1Config(config);
+
+      return 1;
+    }
+
+    weather = getWeatherData(provider, track);
+    freeWeatherProvider(provider);
+
+    if (!weather) {
+      freeF1Config(config);
+
+      return 1;
+    }
   }
 
   if (weather) {
     calcEnhancedPoints(drivers, driverCount, track, condition, weather);
-    freeWeatherData(weather);
   } else {
     calcPoints(drivers, driverCount, track, condition);
   }
@@ -191,6 +625,38 @@ int main(int argc, char *argv[]) {
   calcPercentages(drivers, driverCount);
   predictPositions(drivers, driverCount);
   printResults(drivers, driverCount, track, condition);
+
+  PredictionLog *log = openPredictionLogFromEnv();
+  if (log) {
+    int points[MAX_DRIVERS] = {0};
+    int positions[MAX_DRIVERS] = {0};
+
+    for (int i = 0; i < driverCount; i++) {
+      points[i] = drivers[i].points;
+      positions[i] = drivers[i].predictedPosition;
+    }
+
+    appendPrediction(log, track, weather, drivers, points, positions,
+                     driverCount);
+    closePredictionLog(log);
+  }
+
+  ResultRing *ring = openResultRingFromEnv();
+  if (ring) {
+    int points[MAX_DRIVERS] = {0};
+    int positions[MAX_DRIVERS] = {0};
+
+    for (int i = 0; i < driverCount; i++) {
+      points[i] = drivers[i].points;
+      positions[i] = drivers[i].predictedPosition;
+    }
+
+    publishPrediction(ring, track, condition, weather, drivers, points,
+                      positions, driverCount);
+    closeResultRing(ring);
+  }
+
+  freeWeatherData(weather);
   freeF1Config(config);
 
   return 0;
@@ -201,6 +667,13 @@ void usageInstructions(void) {
   printf("Where [track] is the name of the race track or country\n");
   printf("And [condition] is either 'wet' or 'dry'\n");
   printf("Example: ./grand_prixdictor 'Monza' 'wet'\n");
+  printf("Weekend: ./grand_prixdictor --weekend [track] [condition] [runs]\n");
+  printf("Backtest: ./grand_prixdictor --backtest [log] [results.json]\n");
+  printf("Weather sampling: ./grand_prixdictor --sample-weather [track] "
+         "[draws]\n");
+  printf("Kernel check: ./grand_prixdictor --verify-kernels\n");
+  printf("Live: ./grand_prixdictor --live [track] [condition] [updates]\n");
+  printf("Result ring: F1_RESULT_RING=/f1_results ./grand_prixdictor ...\n");
 }
 
 void toLowercase(char *str) {
@@ -466,191 +939,2563 @@ void printResults(Driver drivers[], int driverCount, const char *track,
          "-----------\n");
 }
 
-F1Configuration *loadF1ConfigFromFile(const char *filename) {
-  F1Configuration *config = malloc(sizeof(F1Configuration));
-  if (!config) {
-    fprintf(stderr, "Failed to allocate memory for configuration\n");
+// FNV-1a, used to key cached session stages on their inputs
+uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  const unsigned char *bytes = data;
 
-    return NULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
   }
 
-  json_error_t error;
-  json_t *root = json_load_file(filename, 0, &error);
-  if (!root) {
-    fprintf(stderr, "Error loading JSON file: %s\n", error.text);
-
-    free(config);
-
-    return NULL;
-  }
+  return hash;
+}
 
-  // Load data
-  json_t *teams = json_object_get(root, "teams");
-  if (!json_is_array(teams)) {
-    fprintf(stderr, "Teams must be an array\n");
+uint64_t hashWeather(uint64_t hash, const WeatherData *weather) {
+  hash = hashBytes(hash, weather->description, strlen(weather->description));
+  hash = hashBytes(hash, &weather->temperature, sizeof(weather->temperature));
+  hash = hashBytes(hash, &weather->humidity, sizeof(weather->humidity));
+  hash = hashBytes(hash, &weather->windSpeed, sizeof(weather->windSpeed));
 
-    json_decref(root);
+  return hashBytes(hash, &weather->rainProbability,
+                   sizeof(weather->rainProbability));
+}
 
-    free(config);
+void initWeekendPipeline(WeekendPipeline *pipeline, const Driver drivers[],
+                         int driverCount, const char *track,
+                         const char *condition) {
+  memset(pipeline, 0, sizeof(WeekendPipeline));
+
+  memcpy(pipeline->drivers, drivers, driverCount * sizeof(Driver));
+  pipeline->driverCount = driverCount;
+  strncpy(pipeline->track, track, MAX_STRING_LENGTH - 1);
+  strncpy(pipeline->condition, condition, MAX_STRING_LENGTH - 1);
+  prepareScoringDrivers(drivers, driverCount, track, pipeline->scoring);
+  pipeline->trackType = getTrackType(track);
+  pipeline->drsEffectiveness = getDRSEffectiveness(track);
+
+  // Everything the pipeline holds is fixed for its lifetime except the
+  // per-session weather, so the track and condition seed every stage key
+  pipeline->baseKey = hashBytes(1469598103934665603ULL, track, strlen(track));
+  pipeline->baseKey =
+      hashBytes(pipeline->baseKey, condition, strlen(condition) + 1);
+}
 
-    return NULL;
+// An explicit race condition applies to the whole weekend, otherwise each
+// session is wet or dry according to its own forecast
+const char *getSessionCondition(const WeekendPipeline *pipeline,
+                                SessionType session) {
+  if (strlen(pipeline->condition) > 0) {
+    return pipeline->condition;
   }
 
-  size_t team_index;
-  json_t *team;
-  json_array_foreach(teams, team_index, team) {
-    if (team_index >= NUM_TEAMS)
-      break;
+  return pipeline->weather[session].rainProbability >= 50 ? "wet" : "dry";
+}
 
-    json_t *name = json_object_get(team, "name");
-    json_t *engine = json_object_get(team, "engine");
-    json_t *isTop = json_object_get(team, "isTopTeam");
-    json_t *pitStop = json_object_get(team, "pitStopEfficiency");
-    json_t *tireStrat = json_object_get(team, "tireStrategy");
-    json_t *aero = json_object_get(team, "aerodynamics");
+uint64_t getStageKey(const WeekendPipeline *pipeline, SessionType session) {
+  uint64_t upstream = pipeline->baseKey;
 
-    if (json_is_string(name)) {
-      strncpy(config->teamNames[team_index], json_string_value(name),
-              MAX_STRING_LENGTH - 1);
-      config->teamNames[team_index][MAX_STRING_LENGTH - 1] = '\0';
-    }
-    if (json_is_string(engine)) {
-      strncpy(config->engines[team_index], json_string_value(engine),
-              MAX_STRING_LENGTH - 1);
-      config->engines[team_index][MAX_STRING_LENGTH - 1] = '\0';
-    }
-    if (json_is_boolean(isTop)) {
-      config->isTopTeam[team_index] = json_boolean_value(isTop);
-    }
-    
-    config->teamPitStopEfficiency[team_index] = json_is_integer(pitStop) ? json_integer_value(pitStop) : 5;
-    config->teamTireStrategy[team_index] = json_is_integer(tireStrat) ? json_integer_value(tireStrat) : 5;
-    config->teamAerodynamics[team_index] = json_is_integer(aero) ? json_integer_value(aero) : 5;
+  if (session == SESSION_QUALIFYING) {
+    upstream = pipeline->stages[SESSION_PRACTICE].key;
+  } else if (session == SESSION_SPRINT || session == SESSION_RACE) {
+    upstream = pipeline->stages[SESSION_QUALIFYING].key;
   }
 
-  json_t *drivers = json_object_get(root, "drivers");
-  if (!json_is_array(drivers)) {
-    fprintf(stderr, "Drivers must be an array\n");
+  uint64_t key = hashBytes(upstream, &session, sizeof(session));
 
-    json_decref(root);
+  return hashWeather(key, &pipeline->weather[session]);
+}
 
-    free(config);
+void runStage(WeekendPipeline *pipeline, SessionType session) {
+  StageResult *stage = &pipeline->stages[session];
+  uint64_t key = getStageKey(pipeline, session);
 
-    return NULL;
+  if (stage->valid && stage->key == key) {
+    pipeline->stageHits[session]++;
+
+    return;
   }
 
-  size_t driver_index;
-  json_t *driver;
-  json_array_foreach(drivers, driver_index, driver) {
-    if (driver_index >= NUM_DRIVERS)
-      break;
+  int driverCount = pipeline->driverCount;
+  const WeatherData *weather = &pipeline->weather[session];
+  int points[MAX_DRIVERS];
 
-    json_t *name = json_object_get(driver, "name");
-    json_t *number = json_object_get(driver, "number");
-    json_t *country = json_object_get(driver, "country");
-    json_t *favTrack = json_object_get(driver, "favoriteTrack");
-    json_t *homeTrack = json_object_get(driver, "homeTrack");
-    json_t *teamIndex = json_object_get(driver, "teamIndex");
-    json_t *isTop = json_object_get(driver, "isTopDriver");
-    json_t *isElite = json_object_get(driver, "isEliteDriver");
-    json_t *overtaking = json_object_get(driver, "overtakingAbility");
-    json_t *consistency = json_object_get(driver, "consistency");
-    json_t *experience = json_object_get(driver, "experienceLevel");
-    json_t *wetSkill = json_object_get(driver, "wetWeatherSkill");
+  ScoringKernel kernel = selectKernelForScenario(
+      pipeline->trackType, getSessionCondition(pipeline, session), weather);
+  kernel(pipeline->scoring, driverCount, pipeline->drsEffectiveness,
+         weather->rainProbability, points);
 
-    if (json_is_string(name)) {
-      strncpy(config->driverNames[driver_index], json_string_value(name),
-              MAX_STRING_LENGTH - 1);
-      config->driverNames[driver_index][MAX_STRING_LENGTH - 1] = '\0';
-    }
-    if (json_is_integer(number))
-      config->driverNumbers[driver_index] = json_integer_value(number);
+  Driver sessionDrivers[MAX_DRIVERS];
+  memcpy(sessionDrivers, pipeline->drivers, driverCount * sizeof(Driver));
 
-    if (json_is_string(country)) {
-      strncpy(config->driverCountries[driver_index], json_string_value(country),
-              MAX_STRING_LENGTH - 1);
-      config->driverCountries[driver_index][MAX_STRING_LENGTH - 1] = '\0';
-    }
-    if (json_is_string(favTrack)) {
-      strncpy(config->driverFavTracks[driver_index],
-              json_string_value(favTrack), MAX_STRING_LENGTH - 1);
-      config->driverFavTracks[driver_index][MAX_STRING_LENGTH - 1] = '\0';
-    }
-    if (json_is_string(homeTrack)) {
-      strncpy(config->driverHomeTracks[driver_index],
-              json_string_value(homeTrack), MAX_STRING_LENGTH - 1);
-      config->driverHomeTracks[driver_index][MAX_STRING_LENGTH - 1] = '\0';
-    }
-    if (json_is_integer(teamIndex))
-      config->driverTeamIndices[driver_index] = json_integer_value(teamIndex);
+  for (int i = 0; i < driverCount; i++) {
+    sessionDrivers[i].points = points[i];
+  }
 
-    if (json_is_boolean(isTop))
-      config->isTopDriver[driver_index] = json_boolean_value(isTop);
+  // Practice pace carries into qualifying; the qualifying grid carries into
+  // both sprint and race, weighted heavier over the shorter sprint distance
+  const StageResult *practice = &pipeline->stages[SESSION_PRACTICE];
+  const StageResult *qualifying = &pipeline->stages[SESSION_QUALIFYING];
 
-    if (json_is_boolean(isElite))
-      config->isEliteDriver[driver_index] = json_boolean_value(isElite);
-      
-    // Load new driver metrics with defaults
-    config->driverOvertaking[driver_index] = json_is_integer(overtaking) ? json_integer_value(overtaking) : 5;
-    config->driverConsistency[driver_index] = json_is_integer(consistency) ? json_integer_value(consistency) : 5;
-    config->driverExperience[driver_index] = json_is_integer(experience) ? json_integer_value(experience) : 5;
-    config->driverWetSkill[driver_index] = json_is_integer(wetSkill) ? json_integer_value(wetSkill) : 5;
+  for (int i = 0; i < driverCount; i++) {
+    int gridBonus = driverCount - qualifying->positions[i];
+
+    if (session == SESSION_QUALIFYING) {
+      sessionDrivers[i].points += practice->points[i] / 4;
+    } else if (session == SESSION_SPRINT) {
+      sessionDrivers[i].points += gridBonus * 2;
+    } else if (session == SESSION_RACE) {
+      sessionDrivers[i].points += gridBonus;
+    }
   }
 
-  json_decref(root);
+  predictPositions(sessionDrivers, driverCount);
 
-  return config;
-}
+  for (int i = 0; i < driverCount; i++) {
+    stage->points[i] = sessionDrivers[i].points;
+    stage->positions[i] = sessionDrivers[i].predictedPosition;
+  }
 
-void freeF1Config(F1Configuration *config) {
-  if (config)
-    free(config);
+  stage->key = key;
+  stage->valid = true;
+  pipeline->stageRuns[session]++;
 }
 
-int getDRSEffectiveness(const char *track) {
-  if (!track) return 5;
-  
-  // High DRS effectiveness tracks
-  if (strcasecmp(track, "Monza") == 0 || strcasecmp(track, "Spa") == 0 ||
-      strcasecmp(track, "Baku") == 0 || strcasecmp(track, "Jeddah") == 0) {
-    return 8;
-  }
-  // Medium DRS effectiveness
-  else if (strcasecmp(track, "Silverstone") == 0 || strcasecmp(track, "Austria") == 0 ||
-           strcasecmp(track, "Bahrain") == 0) {
-    return 6;
+void runWeekendPipeline(WeekendPipeline *pipeline) {
+  for (int session = 0; session < NUM_SESSIONS; session++) {
+    runStage(pipeline, (SessionType)session);
   }
-  // Low DRS effectiveness (street circuits, technical tracks)
-  else if (strcasecmp(track, "Monaco") == 0 || strcasecmp(track, "Hungary") == 0 ||
-           strcasecmp(track, "Singapore") == 0) {
-    return 3;
+}
+
+void printWeekendResults(const WeekendPipeline *pipeline) {
+  static const char *sessionNames[NUM_SESSIONS] = {"Practice", "Qualifying",
+                                                   "Sprint", "Race"};
+
+  printf("\n======= F1 Grand Prix Weekend Predictor =======\n\n");
+  printf("Track: %s\n", pipeline->track);
+
+  for (int session = 0; session < NUM_SESSIONS; session++) {
+    const WeatherData *weather = &pipeline->weather[session];
+    const StageResult *stage = &pipeline->stages[session];
+
+    printf("\n%s (%s, %s, %.1fC, %d%% rain):\n", sessionNames[session],
+           getSessionCondition(pipeline, (SessionType)session),
+           weather->description, weather->temperature,
+           weather->rainProbability);
+    printf("----------------------------------------------\n");
+    printf("| Pos | Driver        | Team           | Pts  |\n");
+    printf("----------------------------------------------\n");
+
+    for (int pos = 1; pos <= pipeline->driverCount; pos++) {
+      for (int i = 0; i < pipeline->driverCount; i++) {
+        if (stage->positions[i] != pos) {
+          continue;
+        }
+
+        printf("| P%-2d | %-13s | %-14s | %-4d |\n", pos,
+               pipeline->drivers[i].name, pipeline->drivers[i].team->name,
+               stage->points[i]);
+      }
+    }
+
+    printf("----------------------------------------------\n");
   }
-  
-  return 5; // Default
 }
 
-// Helper function to categorize track types
-int getTrackType(const char *track) {
-  if (!track) return 3;
-  
-  // Street circuits (1)
-  if (strcasecmp(track, "Monaco") == 0 || strcasecmp(track, "Singapore") == 0 ||
-      strcasecmp(track, "Baku") == 0 || strcasecmp(track, "Jeddah") == 0) {
+int runWeekendMode(int argc, char *argv[], const F1Configuration *config) {
+  Team teams[NUM_TEAMS];
+  Driver drivers[MAX_DRIVERS];
+  int driverCount = 0;
+  char condition[MAX_STRING_LENGTH] = "";
+  long runs = 1;
+
+  if (argc < 3 || argc > 5) {
+    printf("Error: Incorrect usage! Weekend mode takes a track, an optional "
+           "condition and an optional run count.\n");
+    usageInstructions();
+
     return 1;
   }
-  // High-speed tracks (2)
-  else if (strcasecmp(track, "Monza") == 0 || strcasecmp(track, "Spa") == 0 ||
-           strcasecmp(track, "Silverstone") == 0) {
-    return 2;
-  }
-  
-  return 3; // Technical tracks (default)
-}
 
-size_t writeMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
-  size_t realsize = size * nmemb;
-  HTTPResponse *mem = (HTTPResponse *)userp;
-  
+  const char *track = argv[2];
+
+  for (int arg = 3; arg < argc; arg++) {
+    char *end;
+    long parsed = strtol(argv[arg], &end, 10);
+
+    if (*end == '\0' && parsed > 0) {
+      runs = parsed;
+    } else {
+      strncpy(condition, argv[arg], MAX_STRING_LENGTH - 1);
+      toLowercase(condition);
+
+      if (strcmp(condition, "wet") != 0 && strcmp(condition, "dry") != 0) {
+        printf("Error: Incorrect usage! Race condition must be 'wet' or "
+               "'dry'.\n");
+        usageInstructions();
+
+        return 1;
+      }
+    }
+  }
+
+  if (initTeamsAndDrivers(teams, drivers, &driverCount, config) != SUCCESS) {
+    fprintf(stderr, "Failed to initialise teams and drivers\n");
+
+    return 1;
+  }
+
+  WeekendPipeline *pipeline = malloc(sizeof(WeekendPipeline));
+  WeatherProvider *provider =
+      createWeatherProvider(getenv("F1_WEATHER_PROVIDER"));
+  if (!pipeline || !provider) {
+    free(pipeline);
+    freeWeatherProvider(provider);
+
+    return 1;
+  }
+
+  initWeekendPipeline(pipeline, drivers, driverCount, track, condition);
+
+  // Observed weather is the same for every session, so it is fetched
+  // once; only providers that draw fresh weather per fetch are asked again
+  for (int session = 0; session < NUM_SESSIONS; session++) {
+    if (session > 0 && !provider->perDraw) {
+      pipeline->weather[session] = pipeline->weather[0];
+
+      continue;
+    }
+
+    WeatherData *weather = getWeatherData(provider, track);
+    if (!weather) {
+      free(pipeline);
+      freeWeatherProvider(provider);
+
+      return 1;
+    }
+
+    pipeline->weather[session] = *weather;
+    freeWeatherData(weather);
+  }
+
+  freeWeatherProvider(provider);
+
+  runWeekendPipeline(pipeline);
+
+  SimStats *stats = calloc(1, sizeof(SimStats));
+  PredictionLog *log = openPredictionLogFromEnv();
+  ResultRing *ring = openResultRingFromEnv();
+  if (!stats) {
+    free(pipeline);
+    closePredictionLog(log);
+    closeResultRing(ring);
+
+    return 1;
+  }
+
+  const StageResult *race = &pipeline->stages[SESSION_RACE];
+  recordSimulationSample(stats, race->points, race->positions, driverCount);
+
+  if (log) {
+    appendPrediction(log, track, &pipeline->weather[SESSION_RACE], drivers,
+                     race->points, race->positions, driverCount);
+  }
+
+  if (ring) {
+    publishPrediction(ring, track,
+                      getSessionCondition(pipeline, SESSION_RACE),
+                      &pipeline->weather[SESSION_RACE], drivers,
+                      race->points, race->positions, driverCount);
+  }
+
+  // Repeated runs only redraw race-day weather, so practice, qualifying
+  // and sprint come straight from the stage cache after the first run.
+  // getSimulatedWeatherData() and the prediction log aren't thread safe,
+  // so those cases stay on one thread; the result ring takes concurrent
+  // producers.
+  const TrackClimate *climate = findTrackClimate(getClimatology(), track);
+  int threads = (int)getEnvLong("F1_THREADS", 1);
+  if (threads < 1 || !climate || log) {
+    threads = 1;
+  } else if (threads > MAX_SIM_THREADS) {
+    threads = MAX_SIM_THREADS;
+  }
+
+  WeekendWorker *workers = calloc(threads, sizeof(WeekendWorker));
+  pthread_t threadIds[MAX_SIM_THREADS];
+  int started = 0;
+  uint64_t seed = mixBits(getWeatherSeed() + SESSION_RACE);
+
+  for (int t = 0; workers && runs > 1 && t < threads; t++) {
+    WeekendWorker *worker = &workers[t];
+
+    worker->pipeline = *pipeline;
+    memset(worker->pipeline.stageRuns, 0, sizeof(pipeline->stageRuns));
+    memset(worker->pipeline.stageHits, 0, sizeof(pipeline->stageHits));
+    worker->climate = climate;
+    worker->seed = seed;
+    worker->log = log;
+    worker->ring = ring;
+    worker->firstRun = 1 + (runs - 1) * t / threads;
+    worker->lastRun = 1 + (runs - 1) * (t + 1) / threads;
+
+    if (threads == 1) {
+      runWeekendWorker(worker);
+    } else if (pthread_create(&threadIds[t], NULL, runWeekendWorker,
+                              worker) == 0) {
+      started++;
+    } else {
+      // Whatever couldn't get a thread of its own runs here instead
+      runWeekendWorker(worker);
+    }
+  }
+
+  for (int t = 0; t < started; t++) {
+    pthread_join(threadIds[t], NULL);
+  }
+
+  for (int t = 0; workers && runs > 1 && t < threads; t++) {
+    mergeSimStats(stats, &workers[t].stats);
+
+    for (int session = 0; session < NUM_SESSIONS; session++) {
+      pipeline->stageRuns[session] += workers[t].pipeline.stageRuns[session];
+      pipeline->stageHits[session] += workers[t].pipeline.stageHits[session];
+    }
+  }
+
+  closePredictionLog(log);
+  closeResultRing(ring);
+  printWeekendResults(pipeline);
+
+  if (runs > 1) {
+    printSimStats(stats, drivers);
+
+    printf("\nStage runs (cache hits): practice %d (%d), qualifying %d (%d), "
+           "sprint %d (%d), race %d (%d)\n",
+           pipeline->stageRuns[SESSION_PRACTICE],
+           pipeline->stageHits[SESSION_PRACTICE],
+           pipeline->stageRuns[SESSION_QUALIFYING],
+           pipeline->stageHits[SESSION_QUALIFYING],
+           pipeline->stageRuns[SESSION_SPRINT],
+           pipeline->stageHits[SESSION_SPRINT],
+           pipeline->stageRuns[SESSION_RACE],
+           pipeline->stageHits[SESSION_RACE]);
+  }
+
+  free(workers);
+  free(stats);
+  free(pipeline);
+
+  return 0;
+}
+
+// Case-insensitive FNV-1a of the track name, stable across runs
+uint32_t getTrackId(const char *track) {
+  uint32_t hash = 2166136261u;
+
+  for (const char *c = track; *c != '\0'; c++) {
+    hash ^= (unsigned char)tolower((unsigned char)*c);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+// Columns are ordered widest first so every column stays naturally
+// aligned behind the 8-byte aligned block header
+size_t getPredictionColumnOffset(PredictionColumn column, uint32_t rowCount,
+                                 uint32_t driverCount, int driverSlot) {
+  size_t offset = sizeof(PredictionLogBlockHeader);
+  size_t rows = rowCount;
+
+  if (column == COLUMN_TIMESTAMP) return offset;
+  offset += rows * sizeof(int64_t);
+  if (column == COLUMN_TRACK_ID) return offset;
+  offset += rows * sizeof(uint32_t);
+  if (column == COLUMN_TEMPERATURE) return offset;
+  offset += rows * sizeof(float);
+  if (column == COLUMN_HUMIDITY) return offset;
+  offset += rows * sizeof(float);
+  if (column == COLUMN_WIND_SPEED) return offset;
+  offset += rows * sizeof(float);
+  if (column == COLUMN_RAIN_PROBABILITY) return offset;
+  offset += rows * sizeof(int32_t);
+  if (column == COLUMN_SCORE)
+    return offset + driverSlot * rows * sizeof(int32_t);
+  offset += driverCount * rows * sizeof(int32_t);
+  if (column == COLUMN_RANK)
+    return offset + driverSlot * rows * sizeof(uint8_t);
+
+  return offset + driverCount * rows * sizeof(uint8_t);
+}
+
+PredictionLog *openPredictionLog(const char *path) {
+  PredictionLog *log = calloc(1, sizeof(PredictionLog));
+  if (!log) {
+    return NULL;
+  }
+
+  // Other processes may be appending to the same log, so the tail is only
+  // checked, and cut, while holding the lock they take to write a block.
+  // Closing the descriptor drops the lock on every error path below.
+  int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  struct stat fileStat;
+  if (fd < 0 || lockPredictionLog(fd, F_WRLCK) != SUCCESS ||
+      fstat(fd, &fileStat) != 0) {
+    fprintf(stderr, "Failed to open prediction log %s\n", path);
+
+    if (fd >= 0) close(fd);
+    free(log);
+
+    return NULL;
+  }
+
+  // Find the end of the last complete block. Anything after it is a torn
+  // write from a crash, and appending behind it would leave every later
+  // block unreadable, so it is cut off first.
+  size_t fileSize = (size_t)fileStat.st_size;
+  size_t end = 0;
+  PredictionLogFileHeader expected = {PREDICTION_LOG_MAGIC,
+                                      PREDICTION_LOG_VERSION, 0};
+
+  if (fileSize > 0) {
+    // A file shorter than the header only counts as a torn log if what is
+    // there matches the start of one
+    PredictionLogFileHeader fileHeader;
+    size_t headerBytes = fileSize < sizeof(fileHeader) ? fileSize
+                                                       : sizeof(fileHeader);
+    size_t idBytes = offsetof(PredictionLogFileHeader, reserved);
+
+    if (pread(fd, &fileHeader, headerBytes, 0) != (ssize_t)headerBytes ||
+        memcmp(&fileHeader, &expected,
+               headerBytes < idBytes ? headerBytes : idBytes) != 0) {
+      fprintf(stderr, "%s is not a prediction log\n", path);
+
+      close(fd);
+      free(log);
+
+      return NULL;
+    }
+
+    if (headerBytes == sizeof(fileHeader)) {
+      end = findPredictionLogEnd(fd, sizeof(fileHeader), fileSize);
+    }
+  }
+
+  if (cutPredictionLogTail(fd, end, fileSize) != SUCCESS) {
+    close(fd);
+    free(log);
+
+    return NULL;
+  }
+
+  log->file = fdopen(fd, "ab");
+  if (!log->file) {
+    fprintf(stderr, "Failed to open prediction log %s\n", path);
+
+    close(fd);
+    free(log);
+
+    return NULL;
+  }
+
+  if (end == 0) {
+    if (fwrite(&expected, sizeof(expected), 1, log->file) != 1 ||
+        fflush(log->file) != 0) {
+      fprintf(stderr, "Failed to write prediction log %s\n", path);
+
+      fclose(log->file);
+      free(log);
+
+      return NULL;
+    }
+
+    end = sizeof(expected);
+  }
+
+  log->end = end;
+  lockPredictionLog(fd, F_UNLCK);
+
+  return log;
+}
+
+// Whole-file POSIX record lock; F_WRLCK waits for any other writer,
+// F_UNLCK releases it
+int lockPredictionLog(int fd, short type) {
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+
+  while (fcntl(fd, F_SETLKW, &lock) != 0) {
+    if (errno != EINTR) {
+      fprintf(stderr, "Failed to lock prediction log: %s\n", strerror(errno));
+
+      return -1;
+    }
+  }
+
+  return SUCCESS;
+}
+
+// Walks the blocks from start and returns the offset just past the last
+// complete one
+size_t findPredictionLogEnd(int fd, size_t start, size_t fileSize) {
+  PredictionLogBlockHeader block;
+  size_t end = start;
+
+  while (pread(fd, &block, sizeof(block), (off_t)end) ==
+             (ssize_t)sizeof(block) &&
+         isPredictionBlockComplete(&block, fileSize - end)) {
+    end += block.blockBytes;
+  }
+
+  return end;
+}
+
+int cutPredictionLogTail(int fd, size_t end, size_t fileSize) {
+  if (end >= fileSize) {
+    return SUCCESS;
+  }
+
+  fprintf(stderr, "Dropping %zu bytes of incomplete data from the end of "
+          "the prediction log\n", fileSize - end);
+
+  if (ftruncate(fd, (off_t)end) != 0) {
+    fprintf(stderr, "Failed to truncate prediction log: %s\n",
+            strerror(errno));
+
+    return -1;
+  }
+
+  return SUCCESS;
+}
+
+// A block only counts once its header and every column are on disk
+bool isPredictionBlockComplete(const PredictionLogBlockHeader *block,
+                               size_t available) {
+  return block->magic == PREDICTION_BLOCK_MAGIC && block->rowCount > 0 &&
+         block->rowCount <= PREDICTION_LOG_BLOCK_ROWS &&
+         block->driverCount <= MAX_DRIVERS &&
+         block->blockBytes == getPredictionColumnOffset(COLUMN_END,
+                                                        block->rowCount,
+                                                        block->driverCount,
+                                                        0) &&
+         block->blockBytes <= available;
+}
+
+int flushPredictionLog(PredictionLog *log) {
+  uint32_t rows = log->rowCount;
+  if (rows == 0) {
+    return SUCCESS;
+  }
+
+  PredictionLogBlockHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = PREDICTION_BLOCK_MAGIC;
+  header.rowCount = rows;
+  header.driverCount = (uint32_t)log->driverCount;
+  header.rosterHash = log->rosterHash;
+  header.blockBytes = getPredictionColumnOffset(COLUMN_END, rows,
+                                                header.driverCount, 0);
+  memcpy(header.driverNumbers, log->driverNumbers,
+         sizeof(header.driverNumbers));
+
+  header.minTimestamp = header.maxTimestamp = log->timestamps[0];
+  header.minTrackId = header.maxTrackId = log->trackIds[0];
+  header.minRainProbability = header.maxRainProbability =
+      log->rainProbabilities[0];
+  header.minTemperature = header.maxTemperature = log->temperatures[0];
+
+  for (uint32_t row = 1; row < rows; row++) {
+    if (log->timestamps[row] < header.minTimestamp)
+      header.minTimestamp = log->timestamps[row];
+    if (log->timestamps[row] > header.maxTimestamp)
+      header.maxTimestamp = log->timestamps[row];
+    if (log->trackIds[row] < header.minTrackId)
+      header.minTrackId = log->trackIds[row];
+    if (log->trackIds[row] > header.maxTrackId)
+      header.maxTrackId = log->trackIds[row];
+    if (log->rainProbabilities[row] < header.minRainProbability)
+      header.minRainProbability = log->rainProbabilities[row];
+    if (log->rainProbabilities[row] > header.maxRainProbability)
+      header.maxRainProbability = log->rainProbabilities[row];
+    if (log->temperatures[row] < header.minTemperature)
+      header.minTemperature = log->temperatures[row];
+    if (log->temperatures[row] > header.maxTemperature)
+      header.maxTemperature = log->temperatures[row];
+  }
+
+  // The block goes out in several write() calls, so it is written under
+  // the log lock. A writer that died mid-block since this process last
+  // looked leaves a torn tail, which is cut before appending behind it.
+  FILE *file = log->file;
+  int fd = fileno(file);
+  struct stat fileStat;
+
+  log->rowCount = 0;
+
+  if (lockPredictionLog(fd, F_WRLCK) != SUCCESS) {
+    return -1;
+  }
+
+  if (fstat(fd, &fileStat) != 0) {
+    fprintf(stderr, "Failed to write prediction log block\n");
+    lockPredictionLog(fd, F_UNLCK);
+
+    return -1;
+  }
+
+  // Only blocks appended since the last flush need checking, unless the
+  // file was cut short from outside, when it is walked from the start
+  size_t fileSize = (size_t)fileStat.st_size;
+  size_t start = log->end <= fileSize ? log->end
+                                      : sizeof(PredictionLogFileHeader);
+  size_t end = findPredictionLogEnd(fd, start, fileSize);
+
+  if (cutPredictionLogTail(fd, end, fileSize) != SUCCESS) {
+    lockPredictionLog(fd, F_UNLCK);
+
+    return -1;
+  }
+
+  bool written =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(log->timestamps, sizeof(int64_t), rows, file) == rows &&
+      fwrite(log->trackIds, sizeof(uint32_t), rows, file) == rows &&
+      fwrite(log->temperatures, sizeof(float), rows, file) == rows &&
+      fwrite(log->humidities, sizeof(float), rows, file) == rows &&
+      fwrite(log->windSpeeds, sizeof(float), rows, file) == rows &&
+      fwrite(log->rainProbabilities, sizeof(int32_t), rows, file) == rows;
+
+  for (int slot = 0; written && slot < log->driverCount; slot++) {
+    written = fwrite(log->scores[slot], sizeof(int32_t), rows, file) == rows;
+  }
+
+  for (int slot = 0; written && slot < log->driverCount; slot++) {
+    written = fwrite(log->ranks[slot], sizeof(uint8_t), rows, file) == rows;
+  }
+
+  // Flush even after a failed write so nothing is left buffered to go
+  // out once the lock is released
+  bool flushed = fflush(file) == 0;
+
+  if (written && flushed) {
+    log->end = end + header.blockBytes;
+  }
+
+  lockPredictionLog(fd, F_UNLCK);
+
+  if (!written || !flushed) {
+    fprintf(stderr, "Failed to write prediction log block\n");
+
+    return -1;
+  }
+
+  return SUCCESS;
+}
+
+int appendPrediction(PredictionLog *log, const char *track,
+                     const WeatherData *weather, const Driver drivers[],
+                     const int points[], const int positions[],
+                     int driverCount) {
+  uint64_t rosterHash = 1469598103934665603ULL;
+  for (int i = 0; i < driverCount; i++) {
+    rosterHash = hashBytes(rosterHash, &drivers[i].number,
+                           sizeof(drivers[i].number));
+    rosterHash = hashBytes(rosterHash, drivers[i].name,
+                           strlen(drivers[i].name));
+  }
+
+  // A block only ever holds one roster so its slots map to fixed drivers
+  if (log->rowCount > 0 && rosterHash != log->rosterHash) {
+    if (flushPredictionLog(log) != SUCCESS) {
+      return -1;
+    }
+  }
+
+  if (log->rowCount == 0) {
+    log->rosterHash = rosterHash;
+    log->driverCount = driverCount;
+
+    for (int i = 0; i < driverCount; i++) {
+      log->driverNumbers[i] = drivers[i].number;
+    }
+  }
+
+  uint32_t row = log->rowCount++;
+  log->timestamps[row] = (int64_t)time(NULL);
+  log->trackIds[row] = getTrackId(track ? track : "");
+  log->temperatures[row] = weather ? weather->temperature : 0.0f;
+  log->humidities[row] = weather ? weather->humidity : 0.0f;
+  log->windSpeeds[row] = weather ? weather->windSpeed : 0.0f;
+  log->rainProbabilities[row] = weather ? weather->rainProbability : -1;
+
+  for (int slot = 0; slot < driverCount; slot++) {
+    log->scores[slot][row] = points[slot];
+    log->ranks[slot][row] = (uint8_t)positions[slot];
+  }
+
+  if (log->rowCount == PREDICTION_LOG_BLOCK_ROWS) {
+    return flushPredictionLog(log);
+  }
+
+  return SUCCESS;
+}
+
+void closePredictionLog(PredictionLog *log) {
+  if (log) {
+    flushPredictionLog(log);
+    fclose(log->file);
+    free(log);
+  }
+}
+
+PredictionLog *openPredictionLogFromEnv(void) {
+  const char *path = getenv("F1_PREDICTION_LOG");
+  if (!path || strlen(path) == 0) {
+    return NULL;
+  }
+
+  return openPredictionLog(path);
+}
+
+// F1_RESULT_RING names the shared-memory ring, e.g. /f1_results, and
+// F1_RESULT_RING_SLOTS sizes it when this process creates it
+ResultRing *openResultRingFromEnv(void) {
+  const char *name = getenv("F1_RESULT_RING");
+  if (!name || strlen(name) == 0) {
+    return NULL;
+  }
+
+  long slots = getEnvLong("F1_RESULT_RING_SLOTS", RESULT_RING_DEFAULT_SLOTS);
+
+  return createResultRing(name, (uint32_t)slots);
+}
+
+void publishPrediction(ResultRing *ring, const char *track,
+                       const char *condition, const WeatherData *weather,
+                       const Driver drivers[], const int points[],
+                       const int positions[], int driverCount) {
+  RaceResultRecord record;
+  struct timespec now;
+
+  memset(&record, 0, sizeof(record));
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  record.timestampNs = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+  record.trackId = getTrackId(track ? track : "");
+  strncpy(record.track, track ? track : "", RESULT_RING_NAME_LENGTH - 1);
+  strncpy(record.condition, condition ? condition : "",
+          RESULT_RING_CONDITION_LENGTH - 1);
+  record.temperature = weather ? weather->temperature : 0.0f;
+  record.humidity = weather ? weather->humidity : 0.0f;
+  record.windSpeed = weather ? weather->windSpeed : 0.0f;
+  record.rainProbability = weather ? weather->rainProbability : -1;
+
+  if (driverCount > RESULT_RING_MAX_DRIVERS) {
+    driverCount = RESULT_RING_MAX_DRIVERS;
+  }
+
+  record.driverCount = (uint32_t)driverCount;
+
+  for (int i = 0; i < driverCount; i++) {
+    record.driverNumbers[i] = drivers[i].number;
+    record.points[i] = points[i];
+    record.positions[i] = (uint8_t)positions[i];
+  }
+
+  publishRaceResult(ring, &record);
+}
+
+// Actual results file:
+// {"results": [{"track": "Monza", "from": 0, "to": 1900000000,
+//               "order": [81, 4, 16, ...]}]}
+// "from"/"to" are optional unix timestamps bounding which logged
+// predictions are scored against that result.
+int runBacktestMode(int argc, char *argv[]) {
+  if (argc != 4) {
+    printf("Error: Incorrect usage! Backtest mode takes a prediction log and "
+           "a results file.\n");
+    usageInstructions();
+
+    return 1;
+  }
+
+  json_error_t error;
+  json_t *root = json_load_file(argv[3], 0, &error);
+  json_t *results = root ? json_object_get(root, "results") : NULL;
+  if (!json_is_array(results)) {
+    fprintf(stderr, "Error loading results file: %s\n",
+            root ? "results must be an array" : error.text);
+
+    json_decref(root);
+
+    return 1;
+  }
+
+  int fd = open(argv[2], O_RDONLY);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) != 0 ||
+      (size_t)fileStat.st_size < sizeof(PredictionLogFileHeader)) {
+    fprintf(stderr, "Failed to open prediction log %s\n", argv[2]);
+
+    if (fd >= 0) close(fd);
+    json_decref(root);
+
+    return 1;
+  }
+
+  size_t fileSize = (size_t)fileStat.st_size;
+  const unsigned char *data =
+      mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  const PredictionLogFileHeader *fileHeader =
+      (const PredictionLogFileHeader *)data;
+  if (data == MAP_FAILED || fileHeader->magic != PREDICTION_LOG_MAGIC ||
+      fileHeader->version != PREDICTION_LOG_VERSION) {
+    fprintf(stderr, "%s is not a prediction log\n", argv[2]);
+
+    if (data != MAP_FAILED) munmap((void *)data, fileSize);
+    json_decref(root);
+
+    return 1;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  BacktestStats stats;
+  memset(&stats, 0, sizeof(stats));
+
+  size_t result_index;
+  json_t *result;
+  json_array_foreach(results, result_index, result) {
+    json_t *track = json_object_get(result, "track");
+    json_t *order = json_object_get(result, "order");
+    json_t *from = json_object_get(result, "from");
+    json_t *to = json_object_get(result, "to");
+
+    if (!json_is_string(track) || !json_is_array(order) ||
+        json_array_size(order) == 0) {
+      fprintf(stderr, "Skipping result %zu: needs a track and an order\n",
+              result_index);
+      continue;
+    }
+
+    BacktestQuery query;
+    memset(&query, 0, sizeof(query));
+    query.trackId = getTrackId(json_string_value(track));
+    query.from = json_is_integer(from) ? json_integer_value(from) : INT64_MIN;
+    query.to = json_is_integer(to) ? json_integer_value(to) : INT64_MAX;
+
+    size_t position;
+    json_t *number;
+    json_array_foreach(order, position, number) {
+      json_int_t value = json_integer_value(number);
+      if (json_is_integer(number) && value >= 0 && value < MAX_DRIVER_NUMBER) {
+        query.actualPositions[value] = (int)position + 1;
+      }
+    }
+
+    scanPredictionLog(data, fileSize, &query, &stats);
+  }
+
+  munmap((void *)data, fileSize);
+  json_decref(root);
+
+  printf("\n======= F1 Prediction Backtest =======\n\n");
+  printf("Blocks scanned: %llu (skipped by index: %llu)\n",
+         (unsigned long long)stats.blocksScanned,
+         (unsigned long long)stats.blocksSkipped);
+  printf("Predictions scored: %llu of %llu rows read\n",
+         (unsigned long long)stats.predictions,
+         (unsigned long long)stats.rowsRead);
+
+  if (stats.predictions > 0) {
+    printf("Winner accuracy: %.2f%%\n",
+           stats.winnerHits * 100.0 / stats.predictions);
+    printf("Podium overlap: %.2f%%\n",
+           stats.podiumHits * 100.0 / (stats.predictions * 3.0));
+    printf("Mean absolute position error: %.3f\n",
+           stats.positionError / (double)stats.positionsCompared);
+  }
+
+  printf("Elapsed: %.1fms\n", elapsedMs(&start));
+
+  return 0;
+}
+
+// Walks the log once per query, using the block index to skip blocks and
+// touching only the track, timestamp and rank columns of the rest
+void scanPredictionLog(const unsigned char *data, size_t fileSize,
+                       const BacktestQuery *query, BacktestStats *stats) {
+  size_t offset = sizeof(PredictionLogFileHeader);
+
+  while (offset + sizeof(PredictionLogBlockHeader) <= fileSize) {
+    const PredictionLogBlockHeader *block =
+        (const PredictionLogBlockHeader *)(data + offset);
+
+    // A torn final block from an interrupted write ends the scan; the
+    // next openPredictionLog() cuts it off before appending
+    if (!isPredictionBlockComplete(block, fileSize - offset)) {
+      break;
+    }
+
+    size_t blockOffset = offset;
+    offset += block->blockBytes;
+
+    if (query->trackId < block->minTrackId ||
+        query->trackId > block->maxTrackId ||
+        query->to < block->minTimestamp || query->from > block->maxTimestamp) {
+      stats->blocksSkipped++;
+      continue;
+    }
+
+    stats->blocksScanned++;
+
+    uint32_t rows = block->rowCount;
+    uint32_t driverCount = block->driverCount;
+    const unsigned char *base = data + blockOffset;
+    const int64_t *timestamps =
+        (const int64_t *)(base + getPredictionColumnOffset(
+                                     COLUMN_TIMESTAMP, rows, driverCount, 0));
+    const uint32_t *trackIds =
+        (const uint32_t *)(base + getPredictionColumnOffset(
+                                      COLUMN_TRACK_ID, rows, driverCount, 0));
+    const uint8_t *ranks[MAX_DRIVERS];
+    int actual[MAX_DRIVERS];
+
+    for (uint32_t slot = 0; slot < driverCount; slot++) {
+      ranks[slot] = base + getPredictionColumnOffset(COLUMN_RANK, rows,
+                                                     driverCount, (int)slot);
+      int number = block->driverNumbers[slot];
+      actual[slot] = number >= 0 && number < MAX_DRIVER_NUMBER
+                         ? query->actualPositions[number]
+                         : 0;
+    }
+
+    stats->rowsRead += rows;
+
+    for (uint32_t row = 0; row < rows; row++) {
+      if (trackIds[row] != query->trackId || timestamps[row] < query->from ||
+          timestamps[row] > query->to) {
+        continue;
+      }
+
+      stats->predictions++;
+
+      for (uint32_t slot = 0; slot < driverCount; slot++) {
+        int predicted = ranks[slot][row];
+
+        if (actual[slot] > 0) {
+          stats->positionError += abs(predicted - actual[slot]);
+          stats->positionsCompared++;
+        }
+
+        if (predicted == 1 && actual[slot] == 1) {
+          stats->winnerHits++;
+        }
+
+        if (predicted <= 3 && actual[slot] >= 1 && actual[slot] <= 3) {
+          stats->podiumHits++;
+        }
+      }
+    }
+  }
+}
+
+// Fills an evenly spaced inverse-CDF table from an ascending list of
+// quantiles that are themselves evenly spaced in probability, stored as
+// each interval's start and slope
+int loadClimateQuantiles(json_t *values, float base[], float slope[]) {
+  float table[CLIMATE_QUANTILES];
+  size_t count = json_array_size(values);
+  if (count < 2) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    json_t *value = json_array_get(values, i);
+
+    if (!json_is_number(value) ||
+        (i > 0 && json_number_value(value) <
+                      json_number_value(json_array_get(values, i - 1)))) {
+      return -1;
+    }
+  }
+
+  for (int q = 0; q < CLIMATE_QUANTILES; q++) {
+    double position = (double)q / (CLIMATE_QUANTILES - 1) * (count - 1);
+    size_t lower = (size_t)position;
+    if (lower >= count - 1) {
+      lower = count - 2;
+    }
+
+    double low = json_number_value(json_array_get(values, lower));
+    double high = json_number_value(json_array_get(values, lower + 1));
+    table[q] = (float)(low + (position - lower) * (high - low));
+  }
+
+  for (int q = 0; q < CLIMATE_INTERVALS; q++) {
+    base[q] = table[q];
+    slope[q] = table[q + 1] - table[q];
+  }
+
+  return SUCCESS;
+}
+
+// Cumulative regime weights. Counting the thresholds a draw clears picks
+// its regime with compares alone, no table lookup, so it vectorises.
+void buildClimateRegimeTable(TrackClimate *climate, const double weights[]) {
+  const double scale = 1 << CLIMATE_UNIFORM_BITS;
+  double total = 0.0;
+  double cumulative = 0.0;
+
+  for (int i = 0; i < climate->regimeCount; i++) {
+    total += weights[i];
+  }
+
+  for (int i = 0; i < climate->regimeCount; i++) {
+    cumulative += weights[i];
+    climate->regimeThreshold[i] = (int32_t)(cumulative / total * scale + 0.5);
+  }
+
+  // Whatever rounding did, the last regime takes every remaining draw
+  climate->regimeThreshold[climate->regimeCount - 1] = (int32_t)scale;
+}
+
+Climatology *loadClimatologyFromFile(const char *filename) {
+  json_error_t error;
+  json_t *root = json_load_file(filename, 0, &error);
+  if (!root) {
+    return NULL;
+  }
+
+  json_t *circuits = json_object_get(root, "circuits");
+  Climatology *climatology = calloc(1, sizeof(Climatology));
+  if (!json_is_array(circuits) || !climatology) {
+    fprintf(stderr, "Climatology circuits must be an array\n");
+
+    json_decref(root);
+    free(climatology);
+
+    return NULL;
+  }
+
+  static const char *variableNames[NUM_CLIMATE_VARIABLES] = {
+      "temperature", "humidity", "windSpeed", "rainProbability"};
+
+  size_t circuit_index;
+  json_t *circuit;
+  json_array_foreach(circuits, circuit_index, circuit) {
+    if (climatology->trackCount >= MAX_CLIMATE_TRACKS)
+      break;
+
+    TrackClimate *climate = &climatology->tracks[climatology->trackCount];
+    json_t *track = json_object_get(circuit, "track");
+    json_t *aliases = json_object_get(circuit, "aliases");
+    json_t *regimes = json_object_get(circuit, "regimes");
+
+    if (!json_is_string(track) || !json_is_array(regimes) ||
+        json_array_size(regimes) == 0) {
+      fprintf(stderr, "Skipping climatology entry %zu: needs a track and "
+              "regimes\n", circuit_index);
+      continue;
+    }
+
+    memset(climate, 0, sizeof(TrackClimate));
+    strncpy(climate->names[climate->nameCount++], json_string_value(track),
+            MAX_STRING_LENGTH - 1);
+
+    size_t alias_index;
+    json_t *alias;
+    json_array_foreach(aliases, alias_index, alias) {
+      if (climate->nameCount > MAX_CLIMATE_ALIASES)
+        break;
+
+      if (json_is_string(alias)) {
+        strncpy(climate->names[climate->nameCount++], json_string_value(alias),
+                MAX_STRING_LENGTH - 1);
+      }
+    }
+
+    double weights[MAX_CLIMATE_REGIMES];
+    bool valid = true;
+
+    size_t regime_index;
+    json_t *regime;
+    json_array_foreach(regimes, regime_index, regime) {
+      if (regime_index >= MAX_CLIMATE_REGIMES)
+        break;
+
+      json_t *description = json_object_get(regime, "description");
+      json_t *weight = json_object_get(regime, "weight");
+
+      strncpy(climate->descriptions[regime_index],
+              json_is_string(description) ? json_string_value(description)
+                                          : "clear",
+              MAX_STRING_LENGTH - 1);
+      weights[regime_index] = json_is_number(weight) ? json_number_value(weight)
+                                                     : 0.0;
+      valid = valid && weights[regime_index] > 0.0;
+
+      for (int variable = 0; variable < NUM_CLIMATE_VARIABLES; variable++) {
+        json_t *values = json_object_get(regime, variableNames[variable]);
+
+        size_t offset = regime_index * CLIMATE_INTERVALS;
+
+        valid = valid &&
+                loadClimateQuantiles(
+                    values, &climate->intervalBase[variable][offset],
+                    &climate->intervalSlope[variable][offset]) == SUCCESS;
+      }
+
+      climate->regimeCount++;
+    }
+
+    if (!valid) {
+      fprintf(stderr, "Skipping climatology for %s: weights must be positive "
+              "and quantiles ascending\n", climate->names[0]);
+      continue;
+    }
+
+    buildClimateRegimeTable(climate, weights);
+    climatology->trackCount++;
+  }
+
+  json_decref(root);
+
+  return climatology;
+}
+
+void freeClimatology(Climatology *climatology) {
+  if (climatology)
+    free(climatology);
+}
+
+// Loaded once on first use; a missing file just means the built-in
+// simulated profiles are used instead
+const Climatology *getClimatology(void) {
+  static Climatology *climatology = NULL;
+  static bool loaded = false;
+
+  if (!loaded) {
+    const char *path = getenv("F1_CLIMATOLOGY_FILE");
+    climatology =
+        loadClimatologyFromFile(path && strlen(path) > 0 ? path
+                                                         : CLIMATOLOGY_FILE);
+    loaded = true;
+  }
+
+  return climatology;
+}
+
+const TrackClimate *findTrackClimate(const Climatology *climatology,
+                                     const char *location) {
+  if (!climatology || !location) {
+    return NULL;
+  }
+
+  for (int i = 0; i < climatology->trackCount; i++) {
+    const TrackClimate *climate = &climatology->tracks[i];
+
+    for (int name = 0; name < climate->nameCount; name++) {
+      if (strcasecmp(location, climate->names[name]) == 0) {
+        return climate;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// splitmix64 finaliser, for seeds and anything else that needs 64 bits
+uint64_t mixBits(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+  return x ^ (x >> 31);
+}
+
+// 32-bit integer hash (lowbias32). Draws are hashed in 32-bit lanes, which
+// SIMD units handle twice as many of as 64-bit ones.
+uint32_t hashClimateCounter(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+
+  return x ^ (x >> 16);
+}
+
+int32_t getClimateRegime(const TrackClimate *climate, uint32_t bits) {
+  int32_t regime = 0;
+
+  for (int r = 0; r < climate->regimeCount - 1; r++) {
+    regime += (int32_t)bits >= climate->regimeThreshold[r];
+  }
+
+  return regime;
+}
+
+// bits is a 12-bit uniform: its top bits pick the interval and the rest
+// place the draw within it
+float lookupClimateQuantile(const float base[], const float slope[],
+                            int32_t regime, uint32_t bits) {
+  const int fractionBits = CLIMATE_UNIFORM_BITS - CLIMATE_QUANTILE_BITS;
+  int32_t interval =
+      regime * CLIMATE_INTERVALS + (int32_t)(bits >> fractionBits);
+  float fraction = (float)(int32_t)(bits & ((1u << fractionBits) - 1)) *
+                   (1.0f / (1 << fractionBits));
+
+  return base[interval] + fraction * slope[interval];
+}
+
+// Two hashes per draw give 64 bits for five 12-bit uniforms: regime and
+// temperature from the first, humidity and wind from the second, and rain
+// from the top bits of both
+#define CLIMATE_REGIME_BITS(a, b) ((a) & 0xFFF)
+#define CLIMATE_TEMPERATURE_BITS(a, b) (((a) >> 12) & 0xFFF)
+#define CLIMATE_HUMIDITY_BITS(a, b) ((b) & 0xFFF)
+#define CLIMATE_WIND_SPEED_BITS(a, b) (((b) >> 12) & 0xFFF)
+#define CLIMATE_RAIN_BITS(a, b) ((((a) >> 24) << 4) | ((b) >> 28))
+
+// One fixed-size block of consecutive draws. Every loop has a constant
+// trip count and the outputs are restrict, so gcc vectorises each loop at
+// -O2 without runtime alias checks; only the table reads are gathers.
+void sampleClimateBlock(const TrackClimate *climate, uint64_t key,
+                        uint32_t counter, float *restrict temperature,
+                        float *restrict humidity, float *restrict windSpeed,
+                        float *restrict rainProbability,
+                        int *restrict regimes) {
+  uint32_t first[CLIMATE_SAMPLE_LANES];
+  uint32_t second[CLIMATE_SAMPLE_LANES];
+  int32_t regime[CLIMATE_SAMPLE_LANES];
+  uint32_t key0 = (uint32_t)key;
+  uint32_t key1 = (uint32_t)(key >> 32);
+
+  for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+    first[j] = hashClimateCounter((counter + (uint32_t)j) ^ key0);
+    second[j] = hashClimateCounter(first[j] + key1);
+    regime[j] = 0;
+  }
+
+  // Same sum as getClimateRegime(), with the loops swapped so the inner
+  // one runs across lanes
+  for (int r = 0; r < climate->regimeCount - 1; r++) {
+    int32_t threshold = climate->regimeThreshold[r];
+
+    for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+      regime[j] += (int32_t)CLIMATE_REGIME_BITS(first[j], second[j]) >=
+                   threshold;
+    }
+  }
+
+  for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+    temperature[j] = lookupClimateQuantile(
+        climate->intervalBase[CLIMATE_TEMPERATURE],
+        climate->intervalSlope[CLIMATE_TEMPERATURE], regime[j],
+        CLIMATE_TEMPERATURE_BITS(first[j], second[j]));
+  }
+
+  for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+    humidity[j] = lookupClimateQuantile(
+        climate->intervalBase[CLIMATE_HUMIDITY],
+        climate->intervalSlope[CLIMATE_HUMIDITY], regime[j],
+        CLIMATE_HUMIDITY_BITS(first[j], second[j]));
+  }
+
+  for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+    windSpeed[j] = lookupClimateQuantile(
+        climate->intervalBase[CLIMATE_WIND_SPEED],
+        climate->intervalSlope[CLIMATE_WIND_SPEED], regime[j],
+        CLIMATE_WIND_SPEED_BITS(first[j], second[j]));
+  }
+
+  for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+    rainProbability[j] = lookupClimateQuantile(
+        climate->intervalBase[CLIMATE_RAIN_PROBABILITY],
+        climate->intervalSlope[CLIMATE_RAIN_PROBABILITY], regime[j],
+        CLIMATE_RAIN_BITS(first[j], second[j]));
+  }
+
+  for (int j = 0; j < CLIMATE_SAMPLE_LANES; j++) {
+    regimes[j] = regime[j];
+  }
+}
+
+// Counter based: draw i only depends on the seed and i, so batches can
+// be split any way and any run reproduced alone. Whole blocks take the
+// vectorised path; short runs, like a weekend's single race-day draw,
+// take the scalar one, which gives the same numbers.
+void sampleTrackClimate(const TrackClimate *climate, uint64_t seed,
+                        uint64_t first, size_t count, float temperature[],
+                        float humidity[], float windSpeed[],
+                        float rainProbability[], int regimes[]) {
+  size_t done = 0;
+
+  while (done < count) {
+    uint64_t index = first + done;
+    uint32_t counter = (uint32_t)index;
+    uint64_t key = mixBits(seed + (index >> 32));
+
+    // Draws are hashed from the low 32 bits of their index, so a run never
+    // crosses into the next 2^32 draws, which use another key
+    uint64_t run = count - done;
+    if (run > 0x100000000ULL - counter) {
+      run = 0x100000000ULL - counter;
+    }
+
+    if (run >= CLIMATE_SAMPLE_LANES) {
+      sampleClimateBlock(climate, key, counter, temperature + done,
+                         humidity + done, windSpeed + done,
+                         rainProbability + done, regimes + done);
+      done += CLIMATE_SAMPLE_LANES;
+
+      continue;
+    }
+
+    for (uint32_t j = 0; j < run; j++, done++) {
+      uint32_t a = hashClimateCounter((counter + j) ^ (uint32_t)key);
+      uint32_t b = hashClimateCounter(a + (uint32_t)(key >> 32));
+      int32_t regime = getClimateRegime(climate, CLIMATE_REGIME_BITS(a, b));
+
+      temperature[done] = lookupClimateQuantile(
+          climate->intervalBase[CLIMATE_TEMPERATURE],
+          climate->intervalSlope[CLIMATE_TEMPERATURE], regime,
+          CLIMATE_TEMPERATURE_BITS(a, b));
+      humidity[done] = lookupClimateQuantile(
+          climate->intervalBase[CLIMATE_HUMIDITY],
+          climate->intervalSlope[CLIMATE_HUMIDITY], regime,
+          CLIMATE_HUMIDITY_BITS(a, b));
+      windSpeed[done] = lookupClimateQuantile(
+          climate->intervalBase[CLIMATE_WIND_SPEED],
+          climate->intervalSlope[CLIMATE_WIND_SPEED], regime,
+          CLIMATE_WIND_SPEED_BITS(a, b));
+      rainProbability[done] = lookupClimateQuantile(
+          climate->intervalBase[CLIMATE_RAIN_PROBABILITY],
+          climate->intervalSlope[CLIMATE_RAIN_PROBABILITY], regime,
+          CLIMATE_RAIN_BITS(a, b));
+      regimes[done] = regime;
+    }
+  }
+}
+
+void sampleClimateWeather(const TrackClimate *climate, uint64_t seed,
+                          uint64_t index, WeatherData *weather) {
+  float rainProbability;
+  int regime;
+
+  sampleTrackClimate(climate, seed, index, 1, &weather->temperature,
+                     &weather->humidity, &weather->windSpeed, &rainProbability,
+                     &regime);
+
+  strncpy(weather->description, climate->descriptions[regime],
+          MAX_STRING_LENGTH - 1);
+  weather->description[MAX_STRING_LENGTH - 1] = '\0';
+  weather->rainProbability = (int)(rainProbability + 0.5f);
+}
+
+// Seed for bulk weather draws: F1_WEATHER_SEED for reproducible runs,
+// otherwise the clock
+uint64_t getWeatherSeed(void) {
+  const char *value = getenv("F1_WEATHER_SEED");
+  if (value && strlen(value) > 0) {
+    return mixBits(strtoull(value, NULL, 10));
+  }
+
+  return mixBits((uint64_t)time(NULL));
+}
+
+int runSampleWeatherMode(int argc, char *argv[]) {
+  if (argc < 3 || argc > 4) {
+    printf("Error: Incorrect usage! Weather sampling takes a track and an "
+           "optional draw count.\n");
+    usageInstructions();
+
+    return 1;
+  }
+
+  const TrackClimate *climate = findTrackClimate(getClimatology(), argv[2]);
+  if (!climate) {
+    fprintf(stderr, "No climatology for %s\n", argv[2]);
+
+    return 1;
+  }
+
+  char *end = NULL;
+  long long draws = argc == 4 ? strtoll(argv[3], &end, 10) : 100000000LL;
+  if ((end && *end != '\0') || draws <= 0) {
+    fprintf(stderr, "Draw count must be a positive number\n");
+
+    return 1;
+  }
+
+  static float temperature[CLIMATE_SAMPLE_BATCH];
+  static float humidity[CLIMATE_SAMPLE_BATCH];
+  static float windSpeed[CLIMATE_SAMPLE_BATCH];
+  static float rainProbability[CLIMATE_SAMPLE_BATCH];
+  static int regimes[CLIMATE_SAMPLE_BATCH];
+
+  uint64_t seed = getWeatherSeed();
+  double sums[NUM_CLIMATE_VARIABLES] = {0.0};
+  long long regimeCounts[MAX_CLIMATE_REGIMES] = {0};
+
+  // Only the sampling is timed; summarising the draws afterwards is a
+  // serial float reduction and would dominate the figure
+  double elapsed = 0.0;
+
+  for (long long first = 0; first < draws; first += CLIMATE_SAMPLE_BATCH) {
+    size_t count = draws - first < CLIMATE_SAMPLE_BATCH
+                       ? (size_t)(draws - first)
+                       : CLIMATE_SAMPLE_BATCH;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sampleTrackClimate(climate, seed, (uint64_t)first, count, temperature,
+                       humidity, windSpeed, rainProbability, regimes);
+    elapsed += elapsedMs(&start);
+
+    float batchSums[NUM_CLIMATE_VARIABLES] = {0.0f};
+    for (size_t i = 0; i < count; i++) {
+      batchSums[CLIMATE_TEMPERATURE] += temperature[i];
+      batchSums[CLIMATE_HUMIDITY] += humidity[i];
+      batchSums[CLIMATE_WIND_SPEED] += windSpeed[i];
+      batchSums[CLIMATE_RAIN_PROBABILITY] += rainProbability[i];
+      regimeCounts[regimes[i]]++;
+    }
+
+    for (int variable = 0; variable < NUM_CLIMATE_VARIABLES; variable++) {
+      sums[variable] += batchSums[variable];
+    }
+  }
+
+  printf("\n======= F1 Climatology Sampler =======\n\n");
+  printf("Track: %s\n", climate->names[0]);
+  printf("Draws: %lld in %.1fms (%.1f million draws/s)\n", draws, elapsed,
+         draws / (elapsed > 0.0 ? elapsed : 1e-3) / 1000.0);
+  printf("Mean temperature: %.1fC, humidity: %.1f%%, wind: %.1fkm/h, "
+         "rain: %.1f%%\n",
+         sums[CLIMATE_TEMPERATURE] / draws, sums[CLIMATE_HUMIDITY] / draws,
+         sums[CLIMATE_WIND_SPEED] / draws,
+         sums[CLIMATE_RAIN_PROBABILITY] / draws);
+
+  for (int regime = 0; regime < climate->regimeCount; regime++) {
+    printf("  %-16s %6.2f%%\n", climate->descriptions[regime],
+           regimeCounts[regime] * 100.0 / draws);
+  }
+
+  return 0;
+}
+
+// HDR-style bucketing: values below 2 * SUB are exact, above that each
+// power of two is split into SUB buckets, bounding the relative error at
+// 1 / SUB. Negative values clamp to 0.
+int getScoreSketchIndex(int value) {
+  const uint32_t subBuckets = 1u << SCORE_SKETCH_SUB_BUCKET_BITS;
+  uint32_t v = value < 0 ? 0u : (uint32_t)value;
+
+  if (v > SCORE_SKETCH_MAX_VALUE) {
+    v = SCORE_SKETCH_MAX_VALUE;
+  }
+
+  if (v < 2 * subBuckets) {
+    return (int)v;
+  }
+
+  int exponent = 31 - __builtin_clz(v) - SCORE_SKETCH_SUB_BUCKET_BITS;
+
+  return exponent * (int)subBuckets + (int)(v >> exponent);
+}
+
+// Midpoint of the values that land in a bucket
+double getScoreSketchValue(int index) {
+  const int subBuckets = 1 << SCORE_SKETCH_SUB_BUCKET_BITS;
+
+  if (index < 2 * subBuckets) {
+    return index;
+  }
+
+  int exponent = index / subBuckets - 1;
+
+  return getScoreSketchLowerBound(index) + ((1u << exponent) - 1) / 2.0;
+}
+
+// Smallest value that lands in a bucket, so never above any sample in it
+double getScoreSketchLowerBound(int index) {
+  const int subBuckets = 1 << SCORE_SKETCH_SUB_BUCKET_BITS;
+
+  if (index < 2 * subBuckets) {
+    return index;
+  }
+
+  int exponent = index / subBuckets - 1;
+
+  return (double)((uint32_t)(index - exponent * subBuckets) << exponent);
+}
+
+void addScoreSketch(ScoreSketch *sketch, int value) {
+  sketch->counts[getScoreSketchIndex(value)]++;
+  sketch->total++;
+}
+
+void mergeScoreSketch(ScoreSketch *into, const ScoreSketch *from) {
+  for (int i = 0; i < SCORE_SKETCH_BUCKETS; i++) {
+    into->counts[i] += from->counts[i];
+  }
+
+  into->total += from->total;
+}
+
+// Bucket holding the quantile; 0 for an empty sketch
+int getScoreSketchQuantileIndex(const ScoreSketch *sketch, double quantile) {
+  if (sketch->total == 0) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)ceil(quantile * sketch->total);
+  if (rank < 1) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < SCORE_SKETCH_BUCKETS; i++) {
+    seen += sketch->counts[i];
+
+    if (seen >= rank) {
+      return i;
+    }
+  }
+
+  return SCORE_SKETCH_BUCKETS - 1;
+}
+
+double getScoreSketchQuantile(const ScoreSketch *sketch, double quantile) {
+  return getScoreSketchValue(getScoreSketchQuantileIndex(sketch, quantile));
+}
+
+// Welford's update, merged with Chan et al.'s pairwise combination
+void addRunningMoments(RunningMoments *moments, double value) {
+  moments->count++;
+
+  double delta = value - moments->mean;
+  moments->mean += delta / moments->count;
+  moments->m2 += delta * (value - moments->mean);
+}
+
+void mergeRunningMoments(RunningMoments *into, const RunningMoments *from) {
+  if (from->count == 0) {
+    return;
+  }
+
+  uint64_t count = into->count + from->count;
+  double delta = from->mean - into->mean;
+
+  into->mean += delta * from->count / count;
+  into->m2 += from->m2 + delta * delta * into->count * from->count / count;
+  into->count = count;
+}
+
+double getRunningStdDev(const RunningMoments *moments) {
+  return moments->count > 1 ? sqrt(moments->m2 / (moments->count - 1)) : 0.0;
+}
+
+void recordSimulationSample(SimStats *stats, const int points[],
+                            const int positions[], int driverCount) {
+  int winnerPoints = points[0];
+  for (int i = 1; i < driverCount; i++) {
+    if (points[i] > winnerPoints) {
+      winnerPoints = points[i];
+    }
+  }
+
+  for (int i = 0; i < driverCount; i++) {
+    DriverSimStats *driver = &stats->drivers[i];
+
+    driver->positions[positions[i]]++;
+    addRunningMoments(&driver->points, points[i]);
+    addScoreSketch(&driver->pointsSketch, points[i]);
+    addScoreSketch(&driver->gapSketch, winnerPoints - points[i]);
+  }
+
+  stats->driverCount = driverCount;
+  stats->samples++;
+}
+
+void mergeSimStats(SimStats *into, const SimStats *from) {
+  for (int i = 0; i < from->driverCount; i++) {
+    DriverSimStats *driver = &into->drivers[i];
+
+    for (int pos = 0; pos <= MAX_DRIVERS; pos++) {
+      driver->positions[pos] += from->drivers[i].positions[pos];
+    }
+
+    mergeRunningMoments(&driver->points, &from->drivers[i].points);
+    mergeScoreSketch(&driver->pointsSketch, &from->drivers[i].pointsSketch);
+    mergeScoreSketch(&driver->gapSketch, &from->drivers[i].gapSketch);
+  }
+
+  if (from->driverCount > into->driverCount) {
+    into->driverCount = from->driverCount;
+  }
+
+  into->samples += from->samples;
+}
+
+int getMedianPosition(const DriverSimStats *driver, uint64_t samples) {
+  uint64_t seen = 0;
+
+  for (int pos = 1; pos <= MAX_DRIVERS; pos++) {
+    seen += driver->positions[pos];
+
+    if (seen * 2 >= samples) {
+      return pos;
+    }
+  }
+
+  return MAX_DRIVERS;
+}
+
+void printSimStats(const SimStats *stats, const Driver drivers[]) {
+  double samples = stats->samples ? (double)stats->samples : 1.0;
+
+  printf("\nRace distribution over %llu simulated race days:\n",
+         (unsigned long long)stats->samples);
+  printf("-----------------------------------------------------------------"
+         "----------------------\n");
+  printf("| Driver        | Win %%  | Podium %% | Med Pos | Points (mean +/- "
+         "sd) | P10-P90  | Gap |\n");
+  printf("-----------------------------------------------------------------"
+         "----------------------\n");
+
+  for (int i = 0; i < stats->driverCount; i++) {
+    const DriverSimStats *driver = &stats->drivers[i];
+    uint64_t podiums =
+        driver->positions[1] + driver->positions[2] + driver->positions[3];
+
+    printf("| %-13s | %6.2f | %8.2f | %7d | %7.1f +/- %-8.1f | %3.0f-%-4.0f | "
+           "%3.0f |\n",
+           drivers[i].name, driver->positions[1] * 100.0 / samples,
+           podiums * 100.0 / samples, getMedianPosition(driver, stats->samples),
+           driver->points.mean, getRunningStdDev(&driver->points),
+           getScoreSketchQuantile(&driver->pointsSketch, 0.1),
+           getScoreSketchQuantile(&driver->pointsSketch, 0.9),
+           getScoreSketchQuantile(&driver->gapSketch, 0.5));
+  }
+
+  printf("-----------------------------------------------------------------"
+         "----------------------\n");
+}
+
+// Runs race days [firstRun, lastRun) against a private copy of the
+// pipeline and private stats, so workers share nothing until the merge
+void *runWeekendWorker(void *arg) {
+  WeekendWorker *worker = arg;
+  WeekendPipeline *pipeline = &worker->pipeline;
+  const char *track = pipeline->track;
+
+  for (long run = worker->firstRun; run < worker->lastRun; run++) {
+    if (worker->climate) {
+      sampleClimateWeather(worker->climate, worker->seed, (uint64_t)run,
+                           &pipeline->weather[SESSION_RACE]);
+    } else {
+      WeatherData *weather = getSimulatedWeatherData(track);
+      if (!weather) {
+        break;
+      }
+
+      pipeline->weather[SESSION_RACE] = *weather;
+      freeWeatherData(weather);
+    }
+
+    runWeekendPipeline(pipeline);
+
+    const StageResult *race = &pipeline->stages[SESSION_RACE];
+    recordSimulationSample(&worker->stats, race->points, race->positions,
+                           pipeline->driverCount);
+
+    if (worker->log) {
+      appendPrediction(worker->log, track, &pipeline->weather[SESSION_RACE],
+                       pipeline->drivers, race->points, race->positions,
+                       pipeline->driverCount);
+    }
+
+    if (worker->ring) {
+      publishPrediction(worker->ring, track,
+                        getSessionCondition(pipeline, SESSION_RACE),
+                        &pipeline->weather[SESSION_RACE], pipeline->drivers,
+                        race->points, race->positions, pipeline->driverCount);
+    }
+  }
+
+  return NULL;
+}
+
+// Flattens the scenario-invariant part of the scoring (everything
+// calcPoints() awards for a dry race at this track) so kernels only add
+// the terms that depend on track type, condition and weather
+void prepareScoringDrivers(const Driver drivers[], int driverCount,
+                           const char *track, ScoringDriver scoring[]) {
+  Driver baseDrivers[MAX_DRIVERS];
+  memcpy(baseDrivers, drivers, driverCount * sizeof(Driver));
+
+  for (int i = 0; i < driverCount; i++) {
+    baseDrivers[i].points = 0;
+  }
+
+  calcPoints(baseDrivers, driverCount, track, NULL);
+
+  for (int i = 0; i < driverCount; i++) {
+    scoring[i].basePoints = baseDrivers[i].points;
+    scoring[i].isTopDriver = drivers[i].isTopDriver;
+    scoring[i].overtakingAbility = drivers[i].overtakingAbility;
+    scoring[i].consistency = drivers[i].consistency;
+    scoring[i].experienceLevel = drivers[i].experienceLevel;
+    scoring[i].wetWeatherSkill = drivers[i].wetWeatherSkill;
+    scoring[i].pitStopEfficiency = drivers[i].team->pitStopEfficiency;
+    scoring[i].tireStrategy = drivers[i].team->tireStrategy;
+    scoring[i].aerodynamics = drivers[i].team->aerodynamics;
+  }
+}
+
+ScoringKernel selectKernelForScenario(int trackType, const char *condition,
+                                      const WeatherData *weather) {
+  bool wet = condition != NULL && strcmp(condition, "wet") == 0;
+
+  if (!weather) {
+    return selectScoringKernel(trackType, wet, false, 0, 0.0f, 0.0f, 0.0f);
+  }
+
+  return selectScoringKernel(trackType, wet, true, weather->rainProbability,
+                             weather->temperature, weather->windSpeed,
+                             weather->humidity);
+}
+
+// Same result as calcEnhancedPoints(), through the generated kernels
+void calcKernelPoints(Driver drivers[], int driverCount, const char *track,
+                      const char *condition, WeatherData *weather) {
+  ScoringDriver scoring[MAX_DRIVERS];
+  int points[MAX_DRIVERS];
+
+  prepareScoringDrivers(drivers, driverCount, track, scoring);
+
+  ScoringKernel kernel =
+      selectKernelForScenario(getTrackType(track), condition, weather);
+  kernel(scoring, driverCount, getDRSEffectiveness(track),
+         weather ? weather->rainProbability : 0, points);
+
+  for (int i = 0; i < driverCount; i++) {
+    drivers[i].points += points[i];
+  }
+}
+
+// Sweeps tracks, conditions and weather values either side of every band
+// threshold, checking the kernels against the generic reference path
+int runVerifyKernelsMode(const F1Configuration *config) {
+  Team teams[NUM_TEAMS];
+  Driver drivers[MAX_DRIVERS];
+  int driverCount = 0;
+
+  if (initTeamsAndDrivers(teams, drivers, &driverCount, config) != SUCCESS) {
+    fprintf(stderr, "Failed to initialise teams and drivers\n");
+
+    return 1;
+  }
+
+  const char *namedTracks[] = {"",          "Nowhere", "Monza",   "Spa",
+                               "Baku",      "Jeddah",  "Monaco",  "Singapore",
+                               "Silverstone", "Austria", "Bahrain", "Hungary"};
+  const char *conditions[] = {"", "dry", "wet"};
+  const int rains[] = {0, 30, 31, 55, 100};
+  const float temperatures[] = {10.0f, 14.9f, 15.0f, 22.0f, 30.0f, 30.1f, 35.0f};
+  const float winds[] = {5.0f, 20.0f, 20.5f, 35.0f};
+  const float humidities[] = {40.0f, 80.0f, 80.5f, 95.0f};
+
+  // Every driver's favourite, home and country names as well, so the
+  // track affinity bonuses get exercised
+  const char *tracks[12 + 3 * MAX_DRIVERS];
+  int trackCount = 0;
+
+  for (size_t i = 0; i < sizeof(namedTracks) / sizeof(namedTracks[0]); i++) {
+    tracks[trackCount++] = namedTracks[i];
+  }
+
+  for (int i = 0; i < driverCount; i++) {
+    tracks[trackCount++] = drivers[i].favoriteTrack;
+    tracks[trackCount++] = drivers[i].homeTrack;
+    tracks[trackCount++] = drivers[i].country;
+  }
+
+  long scenarios = 0;
+  long mismatches = 0;
+
+  for (int t = 0; t < trackCount; t++) {
+    for (int c = 0; c < 3; c++) {
+      // Index -1 checks the no-weather path
+      for (int w = -1; w < 5 * 7 * 4 * 4; w++) {
+        WeatherData weather = {"verify", 0.0f, 0.0f, 0.0f, 0};
+        WeatherData *scenarioWeather = NULL;
+
+        if (w >= 0) {
+          weather.rainProbability = rains[w % 5];
+          weather.temperature = temperatures[(w / 5) % 7];
+          weather.windSpeed = winds[(w / 35) % 4];
+          weather.humidity = humidities[(w / 140) % 4];
+          scenarioWeather = &weather;
+        }
+
+        Driver generic[MAX_DRIVERS];
+        Driver kernel[MAX_DRIVERS];
+        memcpy(generic, drivers, driverCount * sizeof(Driver));
+        memcpy(kernel, drivers, driverCount * sizeof(Driver));
+
+        calcEnhancedPoints(generic, driverCount, tracks[t], conditions[c],
+                           scenarioWeather);
+        calcKernelPoints(kernel, driverCount, tracks[t], conditions[c],
+                         scenarioWeather);
+
+        scenarios++;
+
+        for (int i = 0; i < driverCount; i++) {
+          if (generic[i].points != kernel[i].points) {
+            if (mismatches < 10) {
+              fprintf(stderr,
+                      "Mismatch: track '%s', condition '%s', weather %d, "
+                      "%s: generic %d, kernel %d\n",
+                      tracks[t], conditions[c], w, drivers[i].name,
+                      generic[i].points, kernel[i].points);
+            }
+
+            mismatches++;
+          }
+        }
+      }
+    }
+  }
+
+  printf("Checked %ld scenarios: %ld mismatches\n", scenarios, mismatches);
+
+  return mismatches == 0 ? 0 : 1;
+}
+
+bool ranksAhead(const LiveSession *session, int a, int b) {
+  if (session->points[a] != session->points[b]) {
+    return session->points[a] > session->points[b];
+  }
+
+  return a < b;
+}
+
+int getRankTreeSize(const RankTree *tree, int node) {
+  return node < 0 ? 0 : tree->size[node];
+}
+
+void updateRankNode(RankTree *tree, int node) {
+  tree->size[node] = 1 + getRankTreeSize(tree, tree->left[node]) +
+                     getRankTreeSize(tree, tree->right[node]);
+}
+
+// Splits a subtree into the drivers ranked ahead of pivot and the rest
+void splitRankTree(const LiveSession *session, RankTree *tree, int node,
+                   int pivot, int *ahead, int *behind) {
+  if (node < 0) {
+    *ahead = *behind = -1;
+
+    return;
+  }
+
+  if (ranksAhead(session, node, pivot)) {
+    splitRankTree(session, tree, tree->right[node], pivot, &tree->right[node],
+                  behind);
+    *ahead = node;
+  } else {
+    splitRankTree(session, tree, tree->left[node], pivot, ahead,
+                  &tree->left[node]);
+    *behind = node;
+  }
+
+  updateRankNode(tree, node);
+}
+
+// Joins two subtrees where every driver in ahead ranks ahead of behind
+int mergeRankTree(RankTree *tree, int ahead, int behind) {
+  if (ahead < 0) return behind;
+  if (behind < 0) return ahead;
+
+  if (tree->priority[ahead] > tree->priority[behind]) {
+    tree->right[ahead] = mergeRankTree(tree, tree->right[ahead], behind);
+    updateRankNode(tree, ahead);
+
+    return ahead;
+  }
+
+  tree->left[behind] = mergeRankTree(tree, ahead, tree->left[behind]);
+  updateRankNode(tree, behind);
+
+  return behind;
+}
+
+int insertRankNode(LiveSession *session, int node, int slot) {
+  RankTree *tree = &session->tree;
+
+  if (node < 0) {
+    tree->left[slot] = tree->right[slot] = -1;
+    tree->size[slot] = 1;
+
+    return slot;
+  }
+
+  if (tree->priority[slot] > tree->priority[node]) {
+    splitRankTree(session, tree, node, slot, &tree->left[slot],
+                  &tree->right[slot]);
+    updateRankNode(tree, slot);
+
+    return slot;
+  }
+
+  if (ranksAhead(session, slot, node)) {
+    tree->left[node] = insertRankNode(session, tree->left[node], slot);
+  } else {
+    tree->right[node] = insertRankNode(session, tree->right[node], slot);
+  }
+
+  updateRankNode(tree, node);
+
+  return node;
+}
+
+// Must run before the driver's points change, while the tree still
+// agrees with them
+int eraseRankNode(LiveSession *session, int node, int slot) {
+  RankTree *tree = &session->tree;
+
+  if (node == slot) {
+    return mergeRankTree(tree, tree->left[node], tree->right[node]);
+  }
+
+  if (ranksAhead(session, slot, node)) {
+    tree->left[node] = eraseRankNode(session, tree->left[node], slot);
+  } else {
+    tree->right[node] = eraseRankNode(session, tree->right[node], slot);
+  }
+
+  updateRankNode(tree, node);
+
+  return node;
+}
+
+int getDriverRank(const LiveSession *session, int slot) {
+  const RankTree *tree = &session->tree;
+  int node = tree->root;
+  int rank = 1;
+
+  while (node != slot) {
+    if (ranksAhead(session, slot, node)) {
+      node = tree->left[node];
+    } else {
+      rank += getRankTreeSize(tree, tree->left[node]) + 1;
+      node = tree->right[node];
+    }
+  }
+
+  return rank + getRankTreeSize(tree, tree->left[slot]);
+}
+
+int selectRankedDriver(const LiveSession *session, int rank) {
+  const RankTree *tree = &session->tree;
+  int node = tree->root;
+
+  while (node >= 0) {
+    int ahead = getRankTreeSize(tree, tree->left[node]);
+
+    if (rank <= ahead) {
+      node = tree->left[node];
+    } else if (rank == ahead + 1) {
+      return node;
+    } else {
+      rank -= ahead + 1;
+      node = tree->right[node];
+    }
+  }
+
+  return -1;
+}
+
+// As in weekend mode, an explicit condition holds for the whole session,
+// otherwise the forecast decides wet or dry
+void selectLiveKernel(LiveSession *session) {
+  const char *condition = session->condition;
+
+  if (strlen(condition) == 0) {
+    condition = session->weather.rainProbability >= 50 ? "wet" : "dry";
+  }
+
+  session->kernel = selectKernelForScenario(session->trackType, condition,
+                                            &session->weather);
+}
+
+// Scores one driver by running the session's kernel over a one-driver slice
+void rescoreLiveDriver(LiveSession *session, int slot) {
+  int points;
+
+  session->kernel(&session->scoring[slot], 1, session->drsEffectiveness,
+                  session->weather.rainProbability, &points);
+  session->points[slot] = points - session->penalties[slot];
+}
+
+// Re-scores the affected drivers and moves them in the rank tree. Only
+// ranks between the highest and lowest old or new position of a moved
+// driver can shift, so that is the only stretch checked for changes.
+int rescoreLiveDrivers(LiveSession *session, const int affected[],
+                       int affectedCount, RankChange changes[]) {
+  RankTree *tree = &session->tree;
+  int first = session->driverCount;
+  int last = 1;
+
+  for (int i = 0; i < affectedCount; i++) {
+    int slot = affected[i];
+
+    if (session->ranks[slot] < first) first = session->ranks[slot];
+    if (session->ranks[slot] > last) last = session->ranks[slot];
+
+    tree->root = eraseRankNode(session, tree->root, slot);
+  }
+
+  for (int i = 0; i < affectedCount; i++) {
+    rescoreLiveDriver(session, affected[i]);
+    tree->root = insertRankNode(session, tree->root, affected[i]);
+  }
+
+  for (int i = 0; i < affectedCount; i++) {
+    int rank = getDriverRank(session, affected[i]);
+
+    if (rank < first) first = rank;
+    if (rank > last) last = rank;
+  }
+
+  int changeCount = 0;
+
+  for (int rank = first; rank <= last; rank++) {
+    int slot = selectRankedDriver(session, rank);
+
+    if (session->ranks[slot] != rank) {
+      changes[changeCount].slot = slot;
+      changes[changeCount].from = session->ranks[slot];
+      changes[changeCount].to = rank;
+      changeCount++;
+
+      session->ranks[slot] = rank;
+    }
+  }
+
+  return changeCount;
+}
+
+// Update lines:
+//   team <name> <pitStopEfficiency|tireStrategy|aerodynamics> <value>
+//   driver <number> <overtakingAbility|consistency|experienceLevel|
+//                    wetWeatherSkill> <value>
+//   driver <number> penalty <points>     (penalties accumulate)
+//   weather <temperature|humidity|windSpeed|rainProbability> <value>
+// Blank lines and lines starting with # are ignored.
+int parseLiveUpdate(LiveSession *session, char *line, int affected[],
+                    int *affectedCount) {
+  char *words[8];
+  int wordCount = 0;
+  char *save = NULL;
+
+  *affectedCount = 0;
+
+  for (char *word = strtok_r(line, " \t\r\n", &save); word && wordCount < 8;
+       word = strtok_r(NULL, " \t\r\n", &save)) {
+    words[wordCount++] = word;
+  }
+
+  if (wordCount < 3) {
+    return -1;
+  }
+
+  const char *field = words[wordCount - 2];
+  char *end;
+  double value = strtod(words[wordCount - 1], &end);
+  if (*end != '\0') {
+    return -1;
+  }
+
+  if (strcmp(words[0], "team") == 0 && wordCount >= 4) {
+    // Team names can contain spaces, so rejoin everything before the field
+    char name[MAX_STRING_LENGTH] = "";
+
+    for (int w = 1; w < wordCount - 2; w++) {
+      if (w > 1) {
+        strncat(name, " ", MAX_STRING_LENGTH - strlen(name) - 1);
+      }
+
+      strncat(name, words[w], MAX_STRING_LENGTH - strlen(name) - 1);
+    }
+
+    for (int i = 0; i < session->driverCount; i++) {
+      if (strcasecmp(session->drivers[i].team->name, name) != 0) {
+        continue;
+      }
+
+      ScoringDriver *scoring = &session->scoring[i];
+
+      if (strcmp(field, "pitStopEfficiency") == 0) {
+        scoring->pitStopEfficiency = (int)value;
+      } else if (strcmp(field, "tireStrategy") == 0) {
+        scoring->tireStrategy = (int)value;
+      } else if (strcmp(field, "aerodynamics") == 0) {
+        scoring->aerodynamics = (int)value;
+      } else {
+        return -1;
+      }
+
+      affected[(*affectedCount)++] = i;
+    }
+
+    return *affectedCount > 0 ? SUCCESS : -1;
+  }
+
+  if (strcmp(words[0], "driver") == 0 && wordCount == 4) {
+    int number = atoi(words[1]);
+
+    for (int i = 0; i < session->driverCount; i++) {
+      if (session->drivers[i].number != number) {
+        continue;
+      }
+
+      ScoringDriver *scoring = &session->scoring[i];
+
+      if (strcmp(field, "penalty") == 0) {
+        session->penalties[i] += (int)value;
+      } else if (strcmp(field, "overtakingAbility") == 0) {
+        scoring->overtakingAbility = (int)value;
+      } else if (strcmp(field, "consistency") == 0) {
+        scoring->consistency = (int)value;
+      } else if (strcmp(field, "experienceLevel") == 0) {
+        scoring->experienceLevel = (int)value;
+      } else if (strcmp(field, "wetWeatherSkill") == 0) {
+        scoring->wetWeatherSkill = (int)value;
+      } else {
+        return -1;
+      }
+
+      affected[(*affectedCount)++] = i;
+
+      return SUCCESS;
+    }
+
+    return -1;
+  }
+
+  if (strcmp(words[0], "weather") == 0 && wordCount == 3) {
+    WeatherData *weather = &session->weather;
+
+    if (strcmp(field, "temperature") == 0) {
+      weather->temperature = (float)value;
+    } else if (strcmp(field, "humidity") == 0) {
+      weather->humidity = (float)value;
+    } else if (strcmp(field, "windSpeed") == 0) {
+      weather->windSpeed = (float)value;
+    } else if (strcmp(field, "rainProbability") == 0) {
+      weather->rainProbability = (int)value;
+    } else {
+      return -1;
+    }
+
+    // Weather feeds every driver's score, so the whole field is re-scored
+    selectLiveKernel(session);
+
+    for (int i = 0; i < session->driverCount; i++) {
+      affected[(*affectedCount)++] = i;
+    }
+
+    return SUCCESS;
+  }
+
+  return -1;
+}
+
+int runLiveMode(int argc, char *argv[], const F1Configuration *config) {
+  Team teams[NUM_TEAMS];
+  Driver drivers[MAX_DRIVERS];
+  int driverCount = 0;
+
+  if (argc < 4 || argc > 5) {
+    printf("Error: Incorrect usage! Live mode takes a track, an optional "
+           "condition and an update file, FIFO or '-' for stdin.\n");
+    usageInstructions();
+
+    return 1;
+  }
+
+  const char *track = argv[2];
+  const char *updatesPath = argv[argc - 1];
+  LiveSession *session = calloc(1, sizeof(LiveSession));
+  if (!session) {
+    return 1;
+  }
+
+  if (argc == 5) {
+    strncpy(session->condition, argv[3], MAX_STRING_LENGTH - 1);
+    toLowercase(session->condition);
+
+    if (strcmp(session->condition, "wet") != 0 &&
+        strcmp(session->condition, "dry") != 0) {
+      printf("Error: Incorrect usage! Race condition must be 'wet' or "
+             "'dry'.\n");
+      usageInstructions();
+      free(session);
+
+      return 1;
+    }
+  }
+
+  if (initTeamsAndDrivers(teams, drivers, &driverCount, config) != SUCCESS) {
+    fprintf(stderr, "Failed to initialise teams and drivers\n");
+    free(session);
+
+    return 1;
+  }
+
+  WeatherProvider *provider =
+      createWeatherProvider(getenv("F1_WEATHER_PROVIDER"));
+  WeatherData *weather = provider ? getWeatherData(provider, track) : NULL;
+  freeWeatherProvider(provider);
+
+  if (!weather) {
+    free(session);
+
+    return 1;
+  }
+
+  session->weather = *weather;
+  freeWeatherData(weather);
+
+  FILE *updates = strcmp(updatesPath, "-") == 0 ? stdin
+                                                : fopen(updatesPath, "r");
+  if (!updates) {
+    fprintf(stderr, "Failed to open update stream %s\n", updatesPath);
+    free(session);
+
+    return 1;
+  }
+
+  memcpy(session->drivers, drivers, driverCount * sizeof(Driver));
+  session->driverCount = driverCount;
+  session->trackType = getTrackType(track);
+  session->drsEffectiveness = getDRSEffectiveness(track);
+  session->tree.root = -1;
+  prepareScoringDrivers(drivers, driverCount, track, session->scoring);
+  selectLiveKernel(session);
+
+  for (int i = 0; i < driverCount; i++) {
+    session->tree.priority[i] = (uint32_t)mixBits((uint64_t)i + 1);
+    rescoreLiveDriver(session, i);
+    session->tree.root = insertRankNode(session, session->tree.root, i);
+  }
+
+  printf("\n======= F1 Grand Prix Live Predictor =======\n\n");
+  printf("Track: %s\n", track);
+  printf("Weather: %s, %.1fC, %d%% rain\n\n", session->weather.description,
+         session->weather.temperature, session->weather.rainProbability);
+
+  for (int rank = 1; rank <= driverCount; rank++) {
+    int slot = selectRankedDriver(session, rank);
+
+    session->ranks[slot] = rank;
+    printf("P%-2d #%-2d %-13s %4d\n", rank, drivers[slot].number,
+           drivers[slot].name, session->points[slot]);
+  }
+
+  printf("\n");
+  fflush(stdout);
+
+  // Latency covers parsing the update through to the list of rank
+  // changes; writing the events out isn't included
+  ScoreSketch *latency = calloc(1, sizeof(ScoreSketch));
+  double maxLatencyUs = 0.0;
+  long applied = 0;
+  long rejected = 0;
+  long rankChanges = 0;
+  char line[MAX_URL_LENGTH];
+  int lineNumber = 0;
+
+  while (latency && fgets(line, sizeof(line), updates)) {
+    lineNumber++;
+
+    const char *start = line + strspn(line, " \t");
+    if (*start == '\0' || *start == '\n' || *start == '#') {
+      continue;
+    }
+
+    char update[MAX_URL_LENGTH];
+    strncpy(update, start, sizeof(update) - 1);
+    update[sizeof(update) - 1] = '\0';
+    update[strcspn(update, "\r\n")] = '\0';
+
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    int affected[MAX_DRIVERS];
+    int affectedCount = 0;
+    RankChange changes[MAX_DRIVERS];
+
+    if (parseLiveUpdate(session, line, affected, &affectedCount) != SUCCESS) {
+      fprintf(stderr, "Line %d: ignoring update '%s'\n", lineNumber, update);
+      rejected++;
+
+      continue;
+    }
+
+    int changeCount =
+        rescoreLiveDrivers(session, affected, affectedCount, changes);
+    double latencyUs = elapsedMs(&started) * 1000.0;
+
+    // Recorded in ns; the sketch covers any int, so only a stall of over
+    // two seconds needs capping
+    addScoreSketch(latency, latencyUs * 1000.0 < SCORE_SKETCH_MAX_VALUE
+                                ? (int)(latencyUs * 1000.0)
+                                : (int)SCORE_SKETCH_MAX_VALUE);
+    if (latencyUs > maxLatencyUs) {
+      maxLatencyUs = latencyUs;
+    }
+
+    applied++;
+    rankChanges += changeCount;
+
+    if (changeCount == 0) {
+      continue;
+    }
+
+    printf("%s:\n", update);
+
+    for (int i = 0; i < changeCount; i++) {
+      const Driver *driver = &drivers[changes[i].slot];
+
+      printf("  #%-2d %-13s P%-2d -> P%-2d (%d pts)\n", driver->number,
+             driver->name, changes[i].from, changes[i].to,
+             session->points[changes[i].slot]);
+    }
+
+    fflush(stdout);
+  }
+
+  if (updates != stdin) {
+    fclose(updates);
+  }
+
+  printf("\nApplied %ld updates (%ld ignored), %ld rank changes\n", applied,
+         rejected, rankChanges);
+
+  if (latency && applied > 0) {
+    // Bucket lower bounds rather than midpoints, so a quantile is never
+    // reported above the latencies that produced it
+    double p50Us = getScoreSketchLowerBound(
+                       getScoreSketchQuantileIndex(latency, 0.5)) /
+                   1000.0;
+    double p99Us = getScoreSketchLowerBound(
+                       getScoreSketchQuantileIndex(latency, 0.99)) /
+                   1000.0;
+
+    printf("Update latency: p50 %.2fus, p99 %.2fus, max %.2fus\n", p50Us,
+           p99Us, maxLatencyUs);
+  }
+
+  free(latency);
+  free(session);
+
+  return 0;
+}
+
+F1Configuration *loadF1ConfigFromFile(const char *filename) {
+  F1Configuration *config = malloc(sizeof(F1Configuration));
+  if (!config) {
+    fprintf(stderr, "Failed to allocate memory for configuration\n");
+
+    return NULL;
+  }
+
+  json_error_t error;
+  json_t *root = json_load_file(filename, 0, &error);
+  if (!root) {
+    fprintf(stderr, "Error loading JSON file: %s\n", error.text);
+
+    free(config);
+
+    return NULL;
+  }
+
+  // Load data
+  json_t *teams = json_object_get(root, "teams");
+  if (!json_is_array(teams)) {
+    fprintf(stderr, "Teams must be an array\n");
+
+    json_decref(root);
+
+    free(config);
+
+    return NULL;
+  }
+
+  size_t team_index;
+  json_t *team;
+  json_array_foreach(teams, team_index, team) {
+    if (team_index >= NUM_TEAMS)
+      break;
+
+    json_t *name = json_object_get(team, "name");
+    json_t *engine = json_object_get(team, "engine");
+    json_t *isTop = json_object_get(team, "isTopTeam");
+    json_t *pitStop = json_object_get(team, "pitStopEfficiency");
+    json_t *tireStrat = json_object_get(team, "tireStrategy");
+    json_t *aero = json_object_get(team, "aerodynamics");
+
+    if (json_is_string(name)) {
+      strncpy(config->teamNames[team_index], json_string_value(name),
+              MAX_STRING_LENGTH - 1);
+      config->teamNames[team_index][MAX_STRING_LENGTH - 1] = '\0';
+    }
+    if (json_is_string(engine)) {
+      strncpy(config->engines[team_index], json_string_value(engine),
+              MAX_STRING_LENGTH - 1);
+      config->engines[team_index][MAX_STRING_LENGTH - 1] = '\0';
+    }
+    if (json_is_boolean(isTop)) {
+      config->isTopTeam[team_index] = json_boolean_value(isTop);
+    }
+    
+    config->teamPitStopEfficiency[team_index] = json_is_integer(pitStop) ? json_integer_value(pitStop) : 5;
+    config->teamTireStrategy[team_index] = json_is_integer(tireStrat) ? json_integer_value(tireStrat) : 5;
+    config->teamAerodynamics[team_index] = json_is_integer(aero) ? json_integer_value(aero) : 5;
+  }
+
+  json_t *drivers = json_object_get(root, "drivers");
+  if (!json_is_array(drivers)) {
+    fprintf(stderr, "Drivers must be an array\n");
+
+    json_decref(root);
+
+    free(config);
+
+    return NULL;
+  }
+
+  size_t driver_index;
+  json_t *driver;
+  json_array_foreach(drivers, driver_index, driver) {
+    if (driver_index >= NUM_DRIVERS)
+      break;
+
+    json_t *name = json_object_get(driver, "name");
+    json_t *number = json_object_get(driver, "number");
+    json_t *country = json_object_get(driver, "country");
+    json_t *favTrack = json_object_get(driver, "favoriteTrack");
+    json_t *homeTrack = json_object_get(driver, "homeTrack");
+    json_t *teamIndex = json_object_get(driver, "teamIndex");
+    json_t *isTop = json_object_get(driver, "isTopDriver");
+    json_t *isElite = json_object_get(driver, "isEliteDriver");
+    json_t *overtaking = json_object_get(driver, "overtakingAbility");
+    json_t *consistency = json_object_get(driver, "consistency");
+    json_t *experience = json_object_get(driver, "experienceLevel");
+    json_t *wetSkill = json_object_get(driver, "wetWeatherSkill");
+
+    if (json_is_string(name)) {
+      strncpy(config->driverNames[driver_index], json_string_value(name),
+              MAX_STRING_LENGTH - 1);
+      config->driverNames[driver_index][MAX_STRING_LENGTH - 1] = '\0';
+    }
+    if (json_is_integer(number))
+      config->driverNumbers[driver_index] = json_integer_value(number);
+
+    if (json_is_string(country)) {
+      strncpy(config->driverCountries[driver_index], json_string_value(country),
+              MAX_STRING_LENGTH - 1);
+      config->driverCountries[driver_index][MAX_STRING_LENGTH - 1] = '\0';
+    }
+    if (json_is_string(favTrack)) {
+      strncpy(config->driverFavTracks[driver_index],
+              json_string_value(favTrack), MAX_STRING_LENGTH - 1);
+      config->driverFavTracks[driver_index][MAX_STRING_LENGTH - 1] = '\0';
+    }
+    if (json_is_string(homeTrack)) {
+      strncpy(config->driverHomeTracks[driver_index],
+              json_string_value(homeTrack), MAX_STRING_LENGTH - 1);
+      config->driverHomeTracks[driver_index][MAX_STRING_LENGTH - 1] = '\0';
+    }
+    if (json_is_integer(teamIndex))
+      config->driverTeamIndices[driver_index] = json_integer_value(teamIndex);
+
+    if (json_is_boolean(isTop))
+      config->isTopDriver[driver_index] = json_boolean_value(isTop);
+
+    if (json_is_boolean(isElite))
+      config->isEliteDriver[driver_index] = json_boolean_value(isElite);
+      
+    // Load new driver metrics with defaults
+    config->driverOvertaking[driver_index] = json_is_integer(overtaking) ? json_integer_value(overtaking) : 5;
+    config->driverConsistency[driver_index] = json_is_integer(consistency) ? json_integer_value(consistency) : 5;
+    config->driverExperience[driver_index] = json_is_integer(experience) ? json_integer_value(experience) : 5;
+    config->driverWetSkill[driver_index] = json_is_integer(wetSkill) ? json_integer_value(wetSkill) : 5;
+  }
+
+  json_decref(root);
+
+  return config;
+}
+
+void freeF1Config(F1Configuration *config) {
+  if (config)
+    free(config);
+}
+
+int getDRSEffectiveness(const char *track) {
+  if (!track) return 5;
+  
+  // High DRS effectiveness tracks
+  if (strcasecmp(track, "Monza") == 0 || strcasecmp(track, "Spa") == 0 ||
+      strcasecmp(track, "Baku") == 0 || strcasecmp(track, "Jeddah") == 0) {
+    return 8;
+  }
+  // Medium DRS effectiveness
+  else if (strcasecmp(track, "Silverstone") == 0 || strcasecmp(track, "Austria") == 0 ||
+           strcasecmp(track, "Bahrain") == 0) {
+    return 6;
+  }
+  // Low DRS effectiveness (street circuits, technical tracks)
+  else if (strcasecmp(track, "Monaco") == 0 || strcasecmp(track, "Hungary") == 0 ||
+           strcasecmp(track, "Singapore") == 0) {
+    return 3;
+  }
+  
+  return 5; // Default
+}
+
+// Helper function to categorize track types
+int getTrackType(const char *track) {
+  if (!track) return 3;
+  
+  // Street circuits (1)
+  if (strcasecmp(track, "Monaco") == 0 || strcasecmp(track, "Singapore") == 0 ||
+      strcasecmp(track, "Baku") == 0 || strcasecmp(track, "Jeddah") == 0) {
+    return 1;
+  }
+  // High-speed tracks (2)
+  else if (strcasecmp(track, "Monza") == 0 || strcasecmp(track, "Spa") == 0 ||
+           strcasecmp(track, "Silverstone") == 0) {
+    return 2;
+  }
+  
+  return 3; // Technical tracks (default)
+}
+
+size_t writeMemoryCallback(void *contents, size_t size, size_t nmemb, void *userp) {
+  size_t realsize = size * nmemb;
+  HTTPResponse *mem = (HTTPResponse *)userp;
+  
   char *ptr = realloc(mem->memory, mem->size + realsize + 1);
   if (!ptr) {
     return 0;
@@ -664,55 +3509,311 @@ size_t writeMemoryCallback(void *contents, size_t size, size_t nmemb, void *user
   return realsize;
 }
 
-WeatherData *getWeatherData(const char *location) {
-  const char *api_key = getenv("OPENWEATHER_API_KEY");
-  if (!api_key || strlen(api_key) == 0) {
-    api_key = WEATHER_API_KEY;
+long getEnvLong(const char *name, long fallback) {
+  const char *value = getenv(name);
+  if (!value || strlen(value) == 0) {
+    return fallback;
   }
-  
-  if (strlen(api_key) == 0) {
-    return getSimulatedWeatherData(location);
+
+  char *end;
+  long parsed = strtol(value, &end, 10);
+
+  return (*end == '\0' && parsed >= 0) ? parsed : fallback;
+}
+
+double elapsedMs(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) * 1000.0 +
+         (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+void sleepMs(long ms) {
+  struct timespec delay = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&delay, NULL);
+}
+
+WeatherProvider *createWeatherProvider(const char *kind) {
+  if (!kind || strlen(kind) == 0) {
+    kind = "live";
   }
-  
-  CURL *curl;
-  CURLcode res;
-  HTTPResponse response = {0};
-  char url[512];
-  
-  snprintf(url, sizeof(url), "%s?q=%s&appid=%s&units=metric", 
-           WEATHER_API_BASE_URL, location, api_key);
-  
-  curl = curl_easy_init();
+
+  WeatherProvider *provider = calloc(1, sizeof(WeatherProvider));
+  if (!provider) {
+    return NULL;
+  }
+
+  const char *filePath = getenv("F1_WEATHER_FILE");
+  strncpy(provider->filePath,
+          filePath && strlen(filePath) > 0 ? filePath : WEATHER_RECORDING_FILE,
+          MAX_URL_LENGTH - 1);
+
+  if (strcasecmp(kind, "live") == 0 || strcasecmp(kind, "record") == 0) {
+    WeatherProvider *live = provider;
+
+    if (strcasecmp(kind, "record") == 0) {
+      live = calloc(1, sizeof(WeatherProvider));
+      if (!live) {
+        free(provider);
+
+        return NULL;
+      }
+
+      provider->name = "record";
+      provider->fetch = fetchRecordingWeather;
+      provider->inner = live;
+    }
+
+    const char *apiKey = getenv("OPENWEATHER_API_KEY");
+    if (!apiKey || strlen(apiKey) == 0) {
+      apiKey = WEATHER_API_KEY;
+    }
+
+    const char *baseUrl = getenv("F1_WEATHER_URL");
+    bool customUrl = baseUrl && strlen(baseUrl) > 0;
+
+    live->name = "live";
+    live->fetch = fetchLiveWeather;
+    live->fetchBody = fetchLiveWeatherBody;
+    strncpy(live->apiKey, apiKey, MAX_URL_LENGTH - 1);
+    strncpy(live->baseUrl, customUrl ? baseUrl : WEATHER_API_BASE_URL,
+            MAX_URL_LENGTH - 1);
+    live->timeoutMs =
+        getEnvLong("F1_WEATHER_TIMEOUT_MS", WEATHER_DEFAULT_TIMEOUT_MS);
+    live->retries = (int)getEnvLong("F1_WEATHER_RETRIES", 0);
+    live->retryDelayMs =
+        getEnvLong("F1_WEATHER_RETRY_DELAY_MS", WEATHER_DEFAULT_RETRY_DELAY_MS);
+
+    // Without a key the real API can only ever refuse us, so don't bother
+    // (a custom URL points at a stub server that doesn't check keys)
+    if (strlen(live->apiKey) == 0 && !customUrl) {
+      live->fetch = NULL;
+      live->fetchBody = NULL;
+      provider->perDraw = true; // always the simulated fallback
+    }
+  } else if (strcasecmp(kind, "replay") == 0) {
+    // Replay exists for deterministic offline runs, so a missing
+    // recording must not quietly turn into random weather
+    provider->name = "replay";
+    provider->fetch = fetchReplayWeather;
+    provider->fetchBody = fetchReplayWeatherBody;
+    provider->noFallback = true;
+  } else if (strcasecmp(kind, "simulated") == 0) {
+    provider->name = "simulated";
+    provider->fetch = fetchSimulatedWeather;
+    provider->perDraw = true;
+  } else {
+    fprintf(stderr,
+            "Unknown weather provider '%s' (expected live, simulated, replay "
+            "or record)\n",
+            kind);
+
+    free(provider);
+
+    return NULL;
+  }
+
+  return provider;
+}
+
+void freeWeatherProvider(WeatherProvider *provider) {
+  if (provider) {
+    freeWeatherProvider(provider->inner);
+    free(provider);
+  }
+}
+
+WeatherData *getWeatherData(WeatherProvider *provider, const char *location) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  WeatherData *weather = NULL;
+  if (provider->fetch) {
+    weather = provider->fetch(provider, location);
+  }
+
+  const char *source = provider->name;
+  if (!weather && provider->noFallback) {
+    fprintf(stderr, "No %s weather for %s\n", provider->name, location);
+    source = "none";
+  } else if (!weather) {
+    weather = getSimulatedWeatherData(location);
+    source = "simulated (fallback)";
+  }
+
+  // Timing goes to stderr so traces can be collected without
+  // disturbing the results table
+  if (getenv("F1_WEATHER_TRACE")) {
+    const WeatherProvider *live = provider->inner ? provider->inner : provider;
+    fprintf(stderr,
+            "weather: provider=%s source=%s attempts=%d elapsed=%.1fms\n",
+            provider->name, source, live->attempts, elapsedMs(&start));
+  }
+
+  return weather;
+}
+
+char *fetchLiveWeatherBody(WeatherProvider *provider, const char *location) {
+  CURL *curl = curl_easy_init();
   if (!curl) {
-    return getSimulatedWeatherData(location);
+    return NULL;
   }
-  
-  response.memory = malloc(1);
-  response.size = 0;
-  
+
+  char *escaped = curl_easy_escape(curl, location, 0);
+  if (!escaped) {
+    curl_easy_cleanup(curl);
+
+    return NULL;
+  }
+
+  char url[MAX_URL_LENGTH * 4];
+  snprintf(url, sizeof(url), "%s?q=%s&appid=%s&units=metric",
+           provider->baseUrl, escaped, provider->apiKey);
+  curl_free(escaped);
+
   curl_easy_setopt(curl, CURLOPT_URL, url);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeMemoryCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-  
-  res = curl_easy_perform(curl);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, provider->timeoutMs);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+  char *body = NULL;
+  long retryDelayMs = provider->retryDelayMs;
+
+  for (int attempt = 0; attempt <= provider->retries; attempt++) {
+    HTTPResponse response = {0};
+    response.memory = malloc(1);
+    if (!response.memory) {
+      break;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&response);
+    provider->attempts++;
+
+    CURLcode res = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+
+    if (res == CURLE_OK && status == 200) {
+      body = response.memory;
+
+      break;
+    }
+
+    free(response.memory);
+
+    if (attempt < provider->retries) {
+      sleepMs(retryDelayMs);
+      retryDelayMs *= 2;
+    }
+  }
+
   curl_easy_cleanup(curl);
-  
-  if (res != CURLE_OK || !response.memory) {
-    if (response.memory) free(response.memory);
-    return getSimulatedWeatherData(location);
+
+  return body;
+}
+
+WeatherData *fetchLiveWeather(WeatherProvider *provider,
+                              const char *location) {
+  char *body = fetchLiveWeatherBody(provider, location);
+  if (!body) {
+    return NULL;
   }
-  
-  WeatherData *weather = parseWeatherResponse(response.memory);
-  free(response.memory);
-  
-  if (!weather) {
-    return getSimulatedWeatherData(location);
+
+  WeatherData *weather = parseWeatherResponse(body);
+  free(body);
+
+  return weather;
+}
+
+// Recordings are one "location<TAB>body" line per response, so bodies have
+// their line breaks flattened before being written
+WeatherData *fetchRecordingWeather(WeatherProvider *provider,
+                                   const char *location) {
+  WeatherProvider *inner = provider->inner;
+  if (!inner->fetchBody) {
+    return inner->fetch ? inner->fetch(inner, location) : NULL;
   }
-  
+
+  char *body = inner->fetchBody(inner, location);
+  if (!body) {
+    return NULL;
+  }
+
+  for (char *c = body; *c != '\0'; c++) {
+    if (*c == '\n' || *c == '\r' || *c == '\t') {
+      *c = ' ';
+    }
+  }
+
+  FILE *file = fopen(provider->filePath, "a");
+  if (file) {
+    fprintf(file, "%s\t%s\n", location, body);
+    fclose(file);
+  } else {
+    fprintf(stderr, "Failed to open weather recording file %s\n",
+            provider->filePath);
+  }
+
+  WeatherData *weather = parseWeatherResponse(body);
+  free(body);
+
+  return weather;
+}
+
+// Returns the most recently recorded body for the location
+char *fetchReplayWeatherBody(WeatherProvider *provider, const char *location) {
+  FILE *file = fopen(provider->filePath, "r");
+  if (!file) {
+    fprintf(stderr, "Failed to open weather recording file %s\n",
+            provider->filePath);
+
+    return NULL;
+  }
+
+  char *body = NULL;
+  char *line = NULL;
+  size_t lineCap = 0;
+  ssize_t lineLength;
+  size_t locationLength = strlen(location);
+
+  while ((lineLength = getline(&line, &lineCap, file)) != -1) {
+    if ((size_t)lineLength <= locationLength ||
+        line[locationLength] != '\t' ||
+        strncasecmp(line, location, locationLength) != 0) {
+      continue;
+    }
+
+    free(body);
+    body = strdup(line + locationLength + 1);
+  }
+
+  free(line);
+  fclose(file);
+
+  return body;
+}
+
+WeatherData *fetchReplayWeather(WeatherProvider *provider,
+                                const char *location) {
+  char *body = fetchReplayWeatherBody(provider, location);
+  if (!body) {
+    return NULL;
+  }
+
+  WeatherData *weather = parseWeatherResponse(body);
+  free(body);
+
   return weather;
 }
 
+WeatherData *fetchSimulatedWeather(WeatherProvider *provider,
+                                   const char *location) {
+  (void)provider;
+
+  return getSimulatedWeatherData(location);
+}
+
 WeatherData *parseWeatherResponse(const char *jsonResponse) {
   json_error_t error;
   json_t *root = json_loads(jsonResponse, 0, &error);
@@ -789,8 +3890,28 @@ WeatherData *parseWeatherResponse(const char *jsonResponse) {
 WeatherData *getSimulatedWeatherData(const char *location) {
   WeatherData *weather = malloc(sizeof(WeatherData));
   if (!weather) return NULL;
+
+  // Circuits with a climatology entry draw from their own distribution
+  const TrackClimate *climate = findTrackClimate(getClimatology(), location);
+  if (climate) {
+    static uint64_t seed = 0;
+    static uint64_t draws = 0;
+
+    if (draws == 0) {
+      seed = getWeatherSeed();
+    }
+
+    sampleClimateWeather(climate, seed, draws++, weather);
+
+    return weather;
+  }
   
-  srand(time(NULL));
+  // Seed once so repeated draws within the same second still differ
+  static bool seeded = false;
+  if (!seeded) {
+    srand(time(NULL));
+    seeded = true;
+  }
   
   if (strcasecmp(location, "Monaco") == 0) {
     strcpy(weather->description, "partly cloudy");
@@ -0,0 +1,385 @@
+/*Copyright (c) 2025 DannyBimma. All Rights Reserved.
+ *
+ * Multi-producer, multi-consumer result ring over named
+ * POSIX shared memory. Producers never wait for readers:
+ * the oldest records are overwritten and each reader
+ * counts what it missed.
+ *
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "result_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SUCCESS 0
+#define RESULT_RING_ATTACH_ATTEMPTS 1000
+#define RESULT_RING_SPIN_LIMIT 100000
+#define RESULT_RING_STALL_TIMEOUT_NS 1000000000L
+
+ResultRing *mapResultRing(int fd, const char *name, bool writable);
+bool isLaterTicketPublished(const ResultRingReader *reader, uint64_t head);
+bool isTicketAbandoned(const ResultRingSlot *slot, uint64_t ticket);
+bool hasReaderStalled(ResultRingReader *reader, uint64_t head);
+
+ResultRing *createResultRing(const char *name, uint32_t slotCount) {
+  if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0) {
+    fprintf(stderr, "Result ring slot count must be a power of two\n");
+
+    return NULL;
+  }
+
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0 && errno == EEXIST) {
+    // Another producer got there first; share its ring
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd >= 0) {
+      ResultRing *ring = mapResultRing(fd, name, true);
+      close(fd);
+
+      return ring;
+    }
+  }
+
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open result ring %s: %s\n", name,
+            strerror(errno));
+
+    return NULL;
+  }
+
+  size_t size = sizeof(ResultRingHeader) +
+                (size_t)slotCount * sizeof(ResultRingSlot);
+
+  if (ftruncate(fd, (off_t)size) != 0) {
+    fprintf(stderr, "Failed to size result ring %s: %s\n", name,
+            strerror(errno));
+    close(fd);
+    shm_unlink(name);
+
+    return NULL;
+  }
+
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (memory == MAP_FAILED) {
+    fprintf(stderr, "Failed to map result ring %s: %s\n", name,
+            strerror(errno));
+    shm_unlink(name);
+
+    return NULL;
+  }
+
+  ResultRing *ring = calloc(1, sizeof(ResultRing));
+  if (!ring) {
+    munmap(memory, size);
+
+    return NULL;
+  }
+
+  // Fresh shared memory is zero filled, so every slot already reads as
+  // "nothing published"; the magic goes in last to mark the ring ready
+  ring->header = memory;
+  ring->slots = (ResultRingSlot *)((char *)memory + sizeof(ResultRingHeader));
+  ring->mappedSize = size;
+  ring->writable = true;
+  ring->header->version = RESULT_RING_VERSION;
+  ring->header->slotSize = sizeof(ResultRingSlot);
+  ring->header->slotCount = slotCount;
+  __atomic_store_n(&ring->header->magic, RESULT_RING_MAGIC, __ATOMIC_RELEASE);
+
+  return ring;
+}
+
+ResultRing *openResultRing(const char *name) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to open result ring %s: %s\n", name,
+            strerror(errno));
+
+    return NULL;
+  }
+
+  ResultRing *ring = mapResultRing(fd, name, false);
+  close(fd);
+
+  return ring;
+}
+
+// Maps an existing ring, giving its creator a moment to finish
+// initialising it, and checks the layout matches this build
+ResultRing *mapResultRing(int fd, const char *name, bool writable) {
+  int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  struct stat info;
+  ResultRingHeader header;
+
+  for (int attempt = 0;; attempt++) {
+    if (fstat(fd, &info) == 0 &&
+        (size_t)info.st_size >= sizeof(ResultRingHeader)) {
+      void *memory =
+          mmap(NULL, sizeof(ResultRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+      if (memory == MAP_FAILED) {
+        fprintf(stderr, "Failed to map result ring %s: %s\n", name,
+                strerror(errno));
+
+        return NULL;
+      }
+
+      const ResultRingHeader *shared = memory;
+      header.magic = __atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE);
+      header.version = shared->version;
+      header.slotSize = shared->slotSize;
+      header.slotCount = shared->slotCount;
+      munmap(memory, sizeof(ResultRingHeader));
+
+      if (header.magic == RESULT_RING_MAGIC) {
+        break;
+      }
+    }
+
+    if (attempt == RESULT_RING_ATTACH_ATTEMPTS) {
+      fprintf(stderr, "%s is not a result ring\n", name);
+
+      return NULL;
+    }
+
+    struct timespec pause = {0, 1000000L};
+    nanosleep(&pause, NULL);
+  }
+
+  if (header.version != RESULT_RING_VERSION ||
+      header.slotSize != sizeof(ResultRingSlot) || header.slotCount == 0 ||
+      (header.slotCount & (header.slotCount - 1)) != 0) {
+    fprintf(stderr, "Result ring %s has an incompatible layout\n", name);
+
+    return NULL;
+  }
+
+  size_t size = sizeof(ResultRingHeader) +
+                (size_t)header.slotCount * sizeof(ResultRingSlot);
+  if ((size_t)info.st_size < size) {
+    fprintf(stderr, "Result ring %s is truncated\n", name);
+
+    return NULL;
+  }
+
+  void *memory = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED) {
+    fprintf(stderr, "Failed to map result ring %s: %s\n", name,
+            strerror(errno));
+
+    return NULL;
+  }
+
+  ResultRing *ring = calloc(1, sizeof(ResultRing));
+  if (!ring) {
+    munmap(memory, size);
+
+    return NULL;
+  }
+
+  ring->header = memory;
+  ring->slots = (ResultRingSlot *)((char *)memory + sizeof(ResultRingHeader));
+  ring->mappedSize = size;
+  ring->writable = writable;
+
+  return ring;
+}
+
+void closeResultRing(ResultRing *ring) {
+  if (ring) {
+    munmap(ring->header, ring->mappedSize);
+    free(ring);
+  }
+}
+
+int unlinkResultRing(const char *name) {
+  if (shm_unlink(name) != 0) {
+    fprintf(stderr, "Failed to remove result ring %s: %s\n", name,
+            strerror(errno));
+
+    return -1;
+  }
+
+  return SUCCESS;
+}
+
+// Claims the next ticket and copies the record into its slot. The only wait
+// is for a producer from an older lap still copying into the same slot,
+// which needs another producer to stall for a whole lap; a record that
+// loses its slot to a newer lap, or gives up waiting, is dropped and
+// counted as superseded.
+uint64_t publishRaceResult(ResultRing *ring, const RaceResultRecord *record) {
+  ResultRingHeader *header = ring->header;
+  uint64_t ticket = __atomic_fetch_add(&header->head, 1, __ATOMIC_RELAXED);
+  ResultRingSlot *slot = &ring->slots[ticket & (header->slotCount - 1)];
+  uint64_t writing = 2 * ticket + 1;
+  uint64_t current = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+
+  for (long spins = 0;; spins++) {
+    if (current >= writing) {
+      // Readers see the newer sequence and count this ticket as lost
+      __atomic_fetch_add(&header->superseded, 1, __ATOMIC_RELAXED);
+
+      return ticket;
+    }
+
+    if (spins == RESULT_RING_SPIN_LIMIT) {
+      // The slot still shows an older ticket, so readers need telling
+      // that this one will never be published
+      uint64_t mark = ticket + 1;
+      uint64_t seen = __atomic_load_n(&slot->abandoned, __ATOMIC_RELAXED);
+
+      while (seen < mark &&
+             !__atomic_compare_exchange_n(&slot->abandoned, &seen, mark, true,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED)) {
+      }
+
+      __atomic_fetch_add(&header->superseded, 1, __ATOMIC_RELAXED);
+
+      return ticket;
+    }
+
+    if ((current & 1) == 0 &&
+        __atomic_compare_exchange_n(&slot->sequence, &current, writing, true,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      break;
+    }
+
+    if (current & 1) {
+      sched_yield();
+      current = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    }
+  }
+
+  // Readers must see the odd sequence before any of the new bytes
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(&slot->record, record, sizeof(RaceResultRecord));
+  __atomic_store_n(&slot->sequence, writing + 1, __ATOMIC_RELEASE);
+
+  return ticket;
+}
+
+// Starts at the next record to be published, or at the oldest one the
+// ring still holds
+void initResultRingReader(ResultRingReader *reader, const ResultRing *ring,
+                          bool fromOldest) {
+  uint64_t head = __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+  uint64_t slotCount = ring->header->slotCount;
+
+  reader->ring = ring;
+  reader->cursor = head;
+  reader->received = 0;
+  reader->lost = 0;
+  reader->stalledTicket = UINT64_MAX;
+  reader->stalledSinceNs = 0;
+
+  if (fromOldest) {
+    reader->cursor = head > slotCount ? head - slotCount : 0;
+  }
+}
+
+// Copies out the next record in ticket order. Returns false when the reader
+// has caught up or the next ticket is still being written, so callers poll.
+// Producers finish out of order, so a later ticket being published says
+// nothing about this one; it is only skipped once its producer has
+// abandoned it, or has been silent for too long to still be alive.
+bool readRaceResult(ResultRingReader *reader, RaceResultRecord *record) {
+  const ResultRingHeader *header = reader->ring->header;
+  uint64_t slotCount = header->slotCount;
+
+  for (;;) {
+    uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (reader->cursor >= head) {
+      return false;
+    }
+
+    // Anything more than a lap behind the head is already overwritten
+    if (head - reader->cursor > slotCount) {
+      reader->lost += head - slotCount - reader->cursor;
+      reader->cursor = head - slotCount;
+    }
+
+    const ResultRingSlot *slot =
+        &reader->ring->slots[reader->cursor & (slotCount - 1)];
+    uint64_t published = 2 * reader->cursor + 2;
+    uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+    if (before < published) {
+      if (!isTicketAbandoned(slot, reader->cursor) &&
+          !hasReaderStalled(reader, head)) {
+        return false;
+      }
+
+      reader->lost++;
+      reader->cursor++;
+
+      continue;
+    }
+
+    if (before == published) {
+      memcpy(record, &slot->record, sizeof(RaceResultRecord));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+      if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == published) {
+        reader->cursor++;
+        reader->received++;
+
+        return true;
+      }
+    }
+
+    // A newer lap took the slot before or while it was copied
+    reader->lost++;
+    reader->cursor++;
+  }
+}
+
+bool isLaterTicketPublished(const ResultRingReader *reader, uint64_t head) {
+  uint64_t slotCount = reader->ring->header->slotCount;
+
+  for (uint64_t ticket = reader->cursor + 1; ticket < head; ticket++) {
+    const ResultRingSlot *slot = &reader->ring->slots[ticket & (slotCount - 1)];
+
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) >= 2 * ticket + 2) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool isTicketAbandoned(const ResultRingSlot *slot, uint64_t ticket) {
+  return __atomic_load_n(&slot->abandoned, __ATOMIC_ACQUIRE) > ticket;
+}
+
+// A producer that died after taking its ticket never publishes or abandons
+// it. Once the reader has waited on one ticket for the stall timeout while
+// later tickets are already out, it gives up on it.
+bool hasReaderStalled(ResultRingReader *reader, uint64_t head) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t nowNs = (int64_t)now.tv_sec * 1000000000L + now.tv_nsec;
+
+  if (reader->stalledTicket != reader->cursor) {
+    reader->stalledTicket = reader->cursor;
+    reader->stalledSinceNs = nowNs;
+
+    return false;
+  }
+
+  return nowNs - reader->stalledSinceNs > RESULT_RING_STALL_TIMEOUT_NS &&
+         isLaterTicketPublished(reader, head);
+}
@@ -0,0 +1,99 @@
+/*Copyright (c) 2025 DannyBimma. All Rights Reserved.
+ *
+ * Fixed-layout prediction records published into a named
+ * POSIX shared-memory ring, so local consumers can read
+ * results with a memcpy instead of parsing stdout.
+ *
+ * */
+
+#ifndef RESULT_RING_H
+#define RESULT_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RESULT_RING_MAGIC 0x474E4952u // "RING"
+#define RESULT_RING_VERSION 3
+#define RESULT_RING_DEFAULT_SLOTS 4096
+#define RESULT_RING_MAX_DRIVERS 20
+#define RESULT_RING_NAME_LENGTH 48
+#define RESULT_RING_CONDITION_LENGTH 8
+#define RESULT_RING_SLOT_SIZE 320 // whole cache lines
+
+// One prediction. Every field is fixed width so producers and consumers
+// built separately agree on the layout; slot i is driver i of the roster.
+typedef struct {
+  int64_t timestampNs; // CLOCK_REALTIME at publish
+  uint32_t trackId;    // same id as the prediction log
+  uint32_t driverCount;
+  char track[RESULT_RING_NAME_LENGTH];
+  char condition[RESULT_RING_CONDITION_LENGTH];
+  float temperature;
+  float humidity;
+  float windSpeed;
+  int32_t rainProbability; // -1 when no weather was available
+  int32_t driverNumbers[RESULT_RING_MAX_DRIVERS];
+  int32_t points[RESULT_RING_MAX_DRIVERS];
+  uint8_t positions[RESULT_RING_MAX_DRIVERS];
+} RaceResultRecord;
+
+// Each slot carries a seqlock sequence: 2t+1 while ticket t is being
+// written, 2t+2 once it is published. Slots are padded to whole cache
+// lines so producers on neighbouring tickets don't share one.
+typedef struct {
+  uint64_t sequence;
+  uint64_t abandoned; // newest ticket + 1 whose producer gave up on the slot
+  RaceResultRecord record;
+  uint8_t padding[RESULT_RING_SLOT_SIZE - 2 * sizeof(uint64_t) -
+                  sizeof(RaceResultRecord)];
+} ResultRingSlot;
+
+typedef char ResultRingSlotSizeCheck[sizeof(ResultRingSlot) ==
+                                             RESULT_RING_SLOT_SIZE
+                                         ? 1
+                                         : -1];
+
+// Shared header. The producer counters sit on their own cache lines so
+// publishing doesn't bounce the line readers use to check the layout.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slotSize;
+  uint32_t slotCount; // power of two
+  uint8_t reserved[48];
+  uint64_t head;      // next ticket to hand out
+  uint8_t headPadding[56];
+  uint64_t superseded; // writes abandoned because a newer lap won the slot
+  uint8_t supersededPadding[56];
+} ResultRingHeader;
+
+typedef struct {
+  ResultRingHeader *header;
+  ResultRingSlot *slots;
+  size_t mappedSize;
+  bool writable;
+} ResultRing;
+
+// Each reader keeps its own cursor, so any number of consumers can follow
+// the same ring without coordinating with the producers or each other
+typedef struct {
+  const ResultRing *ring;
+  uint64_t cursor;
+  uint64_t received;
+  uint64_t lost; // records overwritten or abandoned before this reader
+                 // got to them
+  uint64_t stalledTicket; // ticket the reader has been waiting on
+  int64_t stalledSinceNs;
+} ResultRingReader;
+
+ResultRing *createResultRing(const char *name, uint32_t slotCount);
+ResultRing *openResultRing(const char *name);
+void closeResultRing(ResultRing *ring);
+int unlinkResultRing(const char *name);
+uint64_t publishRaceResult(ResultRing *ring, const RaceResultRecord *record);
+void initResultRingReader(ResultRingReader *reader, const ResultRing *ring,
+                          bool fromOldest);
+bool readRaceResult(ResultRingReader *reader, RaceResultRecord *record);
+
+#endif
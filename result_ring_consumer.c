@@ -0,0 +1,185 @@
+/*Copyright (c) 2025 DannyBimma. All Rights Reserved.
+ *
+ * Demo consumer for the predictor's shared-memory result
+ * ring: follows the ring, prints each result or just a
+ * throughput summary, and reports any records it lost.
+ *
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "result_ring.h"
+
+#define DEFAULT_RING_NAME "/f1_results"
+#define IDLE_POLL_NS 50000L
+
+typedef struct {
+  const char *name;
+  bool fromOldest;
+  bool quiet;
+  bool unlink;
+  long maxResults;
+  long idleTimeoutMs;
+} ConsumerOptions;
+
+void usageInstructions(void);
+int parseOptions(int argc, char *argv[], ConsumerOptions *options);
+int64_t nowNs(void);
+void printRaceResult(const RaceResultRecord *record, int64_t latencyNs);
+
+int main(int argc, char *argv[]) {
+  ConsumerOptions options = {DEFAULT_RING_NAME, false, false, false, 0, 0};
+
+  if (parseOptions(argc, argv, &options) != 0) {
+    usageInstructions();
+
+    return 1;
+  }
+
+  ResultRing *ring = openResultRing(options.name);
+  if (!ring) {
+    return 1;
+  }
+
+  ResultRingReader reader;
+  initResultRingReader(&reader, ring, options.fromOldest);
+
+  RaceResultRecord record;
+  int64_t started = nowNs();
+  int64_t lastResult = started;
+  int64_t totalLatencyNs = 0;
+  int64_t maxLatencyNs = 0;
+
+  while (!options.maxResults || (long)reader.received < options.maxResults) {
+    if (!readRaceResult(&reader, &record)) {
+      if (options.idleTimeoutMs &&
+          nowNs() - lastResult > options.idleTimeoutMs * 1000000L) {
+        break;
+      }
+
+      struct timespec pause = {0, IDLE_POLL_NS};
+      nanosleep(&pause, NULL);
+
+      continue;
+    }
+
+    lastResult = nowNs();
+    int64_t latencyNs = lastResult - record.timestampNs;
+    totalLatencyNs += latencyNs;
+    if (latencyNs > maxLatencyNs) {
+      maxLatencyNs = latencyNs;
+    }
+
+    if (!options.quiet) {
+      printRaceResult(&record, latencyNs);
+    }
+  }
+
+  double seconds = (lastResult - started) / 1e9;
+  fprintf(stderr,
+          "Received %llu results, lost %llu, producers superseded %llu "
+          "(%.0f results/s, latency mean %.1fus max %.1fus)\n",
+          (unsigned long long)reader.received,
+          (unsigned long long)reader.lost,
+          (unsigned long long)ring->header->superseded,
+          seconds > 0 ? reader.received / seconds : 0.0,
+          reader.received ? totalLatencyNs / 1e3 / reader.received : 0.0,
+          maxLatencyNs / 1e3);
+
+  closeResultRing(ring);
+
+  if (options.unlink) {
+    unlinkResultRing(options.name);
+  }
+
+  return 0;
+}
+
+void usageInstructions(void) {
+  printf("Usage: ./result_ring_consumer [options] [ring name]\n");
+  printf("  -o           Start from the oldest record still in the ring\n");
+  printf("  -q           Only print the summary\n");
+  printf("  -n count     Exit after this many results\n");
+  printf("  -i ms        Exit after this long without a new result\n");
+  printf("  -u           Remove the ring on exit\n");
+  printf("The ring name defaults to %s\n", DEFAULT_RING_NAME);
+  printf("Example: ./result_ring_consumer -q -i 2000 /f1_results\n");
+}
+
+int parseOptions(int argc, char *argv[], ConsumerOptions *options) {
+  int opt;
+
+  while ((opt = getopt(argc, argv, "oqn:i:u")) != -1) {
+    long value = optarg ? strtol(optarg, NULL, 10) : 0;
+    if (value < 0) {
+      return -1;
+    }
+
+    switch (opt) {
+    case 'o':
+      options->fromOldest = true;
+      break;
+    case 'q':
+      options->quiet = true;
+      break;
+    case 'n':
+      options->maxResults = value;
+      break;
+    case 'i':
+      options->idleTimeoutMs = value;
+      break;
+    case 'u':
+      options->unlink = true;
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  if (optind < argc - 1) {
+    return -1;
+  }
+
+  if (optind == argc - 1) {
+    options->name = argv[optind];
+  }
+
+  return 0;
+}
+
+int64_t nowNs(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  return (int64_t)now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+void printRaceResult(const RaceResultRecord *record, int64_t latencyNs) {
+  int podium[3] = {-1, -1, -1};
+
+  for (uint32_t i = 0; i < record->driverCount; i++) {
+    if (record->positions[i] >= 1 && record->positions[i] <= 3) {
+      podium[record->positions[i] - 1] = (int)i;
+    }
+  }
+
+  printf("%-12s %-3s %5.1fC %3d%% rain |", record->track,
+         strlen(record->condition) > 0 ? record->condition : "-",
+         record->temperature, record->rainProbability);
+
+  for (int pos = 0; pos < 3; pos++) {
+    if (podium[pos] >= 0) {
+      printf(" P%d #%-2d %4d", pos + 1, record->driverNumbers[podium[pos]],
+             record->points[podium[pos]]);
+    }
+  }
+
+  printf(" | %.1fus\n", latencyNs / 1e3);
+}
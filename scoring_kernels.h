@@ -0,0 +1,38 @@
+/*Copyright (c) 2025 DannyBimma. All Rights Reserved.
+ *
+ * Specialised scoring kernels generated at build time from
+ * scoring_rules.def, one per (track type, condition,
+ * weather band) combination.
+ *
+ * */
+
+#ifndef SCORING_KERNELS_H
+#define SCORING_KERNELS_H
+
+#include <stdbool.h>
+
+// Per-driver inputs flattened for the kernels. basePoints holds everything
+// calcPoints() awards apart from the wet condition bonus.
+typedef struct {
+  int basePoints;
+  int isTopDriver;
+  int overtakingAbility;
+  int consistency;
+  int experienceLevel;
+  int wetWeatherSkill;
+  int pitStopEfficiency;
+  int tireStrategy;
+  int aerodynamics;
+} ScoringDriver;
+
+// Writes each driver's total points; the scenario is baked into the kernel
+typedef void (*ScoringKernel)(const ScoringDriver drivers[], int driverCount,
+                              int drs, int rainProbability, int points[]);
+
+// Picks the kernel for a scenario once so the per-driver loop never
+// re-tests the track type, condition or weather thresholds
+ScoringKernel selectScoringKernel(int trackType, bool wet, bool hasWeather,
+                                  int rainProbability, float temperature,
+                                  float windSpeed, float humidity);
+
+#endif
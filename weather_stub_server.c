@@ -0,0 +1,273 @@
+/*Copyright (c) 2025 DannyBimma. All Rights Reserved.
+ *
+ * A local stand-in for the OpenWeatherMap current weather
+ * endpoint, used to exercise the predictor's weather I/O
+ * path with injected latency, jitter, errors and slow-drip
+ * response bodies.
+ *
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_PORT 8080
+#define REQUEST_BUFFER_SIZE 4096
+#define MAX_LOCATION_LENGTH 64
+
+typedef struct {
+  int port;
+  long latencyMs;
+  long jitterMs;
+  int errorPercent;
+  int errorStatus;
+  int dripBytes;
+  long dripIntervalMs;
+  long maxRequests;
+  unsigned int seed;
+} StubOptions;
+
+void usageInstructions(void);
+int parseOptions(int argc, char *argv[], StubOptions *options);
+void sleepMs(long ms);
+void extractLocation(const char *request, char *location, size_t size);
+bool sendAll(int client, const char *data, size_t length);
+void serveRequest(int client, const StubOptions *options);
+
+int main(int argc, char *argv[]) {
+  StubOptions options = {DEFAULT_PORT, 0, 0, 0, 500, 0, 0, 0, 0};
+
+  if (parseOptions(argc, argv, &options) != 0) {
+    usageInstructions();
+
+    return 1;
+  }
+
+  srand(options.seed ? options.seed : (unsigned int)time(NULL));
+
+  // Clients that time out mid-drip must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  if (server < 0) {
+    perror("socket");
+
+    return 1;
+  }
+
+  int reuse = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(options.port);
+
+  if (bind(server, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(server, 16) < 0) {
+    perror("bind");
+    close(server);
+
+    return 1;
+  }
+
+  fprintf(stderr,
+          "Weather stub listening on http://127.0.0.1:%d/data/2.5/weather "
+          "(latency=%ldms jitter=%ldms errors=%d%% drip=%dB/%ldms)\n",
+          options.port, options.latencyMs, options.jitterMs,
+          options.errorPercent, options.dripBytes, options.dripIntervalMs);
+
+  for (long served = 0; !options.maxRequests || served < options.maxRequests;
+       served++) {
+    int client = accept(server, NULL, NULL);
+    if (client < 0) {
+      continue;
+    }
+
+    serveRequest(client, &options);
+    close(client);
+  }
+
+  close(server);
+
+  return 0;
+}
+
+void usageInstructions(void) {
+  printf("Usage: ./weather_stub_server [options]\n");
+  printf("  -p port      Port to listen on (default %d)\n", DEFAULT_PORT);
+  printf("  -l ms        Latency before the response starts\n");
+  printf("  -j ms        Random jitter added on top of the latency\n");
+  printf("  -e percent   Share of requests answered with an error\n");
+  printf("  -s status    HTTP status used for errors (default 500)\n");
+  printf("  -d bytes     Drip the body out this many bytes at a time\n");
+  printf("  -i ms        Pause between drip chunks\n");
+  printf("  -n count     Exit after serving this many requests\n");
+  printf("  -r seed      Seed for jitter and error injection\n");
+  printf("Example: ./weather_stub_server -l 200 -j 50 -e 10 -d 16 -i 100\n");
+}
+
+int parseOptions(int argc, char *argv[], StubOptions *options) {
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:l:j:e:s:d:i:n:r:")) != -1) {
+    long value = strtol(optarg, NULL, 10);
+    if (value < 0) {
+      return -1;
+    }
+
+    switch (opt) {
+    case 'p':
+      options->port = (int)value;
+      break;
+    case 'l':
+      options->latencyMs = value;
+      break;
+    case 'j':
+      options->jitterMs = value;
+      break;
+    case 'e':
+      options->errorPercent = (int)value;
+      break;
+    case 's':
+      options->errorStatus = (int)value;
+      break;
+    case 'd':
+      options->dripBytes = (int)value;
+      break;
+    case 'i':
+      options->dripIntervalMs = value;
+      break;
+    case 'n':
+      options->maxRequests = value;
+      break;
+    case 'r':
+      options->seed = (unsigned int)value;
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  return optind == argc ? 0 : -1;
+}
+
+void sleepMs(long ms) {
+  struct timespec delay = {ms / 1000, (ms % 1000) * 1000000L};
+  nanosleep(&delay, NULL);
+}
+
+// Pulls the q= parameter out of the request line, undoing the
+// %XX and '+' escapes curl applies
+void extractLocation(const char *request, char *location, size_t size) {
+  const char *query = strstr(request, "q=");
+  size_t length = 0;
+
+  if (query) {
+    for (const char *c = query + 2;
+         *c != '\0' && *c != '&' && *c != ' ' && length < size - 1; c++) {
+      unsigned int decoded;
+
+      if (*c == '%' && sscanf(c + 1, "%2x", &decoded) == 1) {
+        location[length++] = (char)decoded;
+        c += 2;
+      } else {
+        location[length++] = *c == '+' ? ' ' : *c;
+      }
+    }
+  }
+
+  if (length == 0) {
+    strncpy(location, "Unknown", size - 1);
+    length = strlen(location);
+  }
+
+  location[length] = '\0';
+}
+
+bool sendAll(int client, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t sent = send(client, data, length, 0);
+    if (sent <= 0) {
+      return false;
+    }
+
+    data += sent;
+    length -= (size_t)sent;
+  }
+
+  return true;
+}
+
+void serveRequest(int client, const StubOptions *options) {
+  char request[REQUEST_BUFFER_SIZE];
+  ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+  if (received <= 0) {
+    return;
+  }
+  request[received] = '\0';
+
+  char location[MAX_LOCATION_LENGTH];
+  extractLocation(request, location, sizeof(location));
+
+  long delay = options->latencyMs;
+  if (options->jitterMs > 0) {
+    delay += rand() % (options->jitterMs + 1);
+  }
+  sleepMs(delay);
+
+  bool fail = options->errorPercent > 0 && rand() % 100 < options->errorPercent;
+  int status = fail ? options->errorStatus : 200;
+
+  // Same shape as the real API so parseWeatherResponse() is exercised
+  char body[512];
+  if (fail) {
+    snprintf(body, sizeof(body),
+             "{\"cod\":%d,\"message\":\"injected failure\"}", status);
+  } else {
+    snprintf(body, sizeof(body),
+             "{\"name\":\"%s\",\"weather\":[{\"main\":\"Clouds\","
+             "\"description\":\"stub clouds\"}],\"main\":{\"temp\":%.1f,"
+             "\"humidity\":%d},\"wind\":{\"speed\":%.1f},\"clouds\":{\"all\":"
+             "%d},\"cod\":200}",
+             location, 18.0 + rand() % 150 / 10.0, 50 + rand() % 45,
+             1.0 + rand() % 80 / 10.0, rand() % 100);
+  }
+
+  char header[256];
+  int headerLength = snprintf(header, sizeof(header),
+                              "HTTP/1.1 %d %s\r\n"
+                              "Content-Type: application/json\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n",
+                              status, fail ? "Error" : "OK", strlen(body));
+
+  if (!sendAll(client, header, (size_t)headerLength)) {
+    return;
+  }
+
+  size_t bodyLength = strlen(body);
+  size_t chunk = options->dripBytes > 0 ? (size_t)options->dripBytes
+                                        : bodyLength;
+
+  for (size_t offset = 0; offset < bodyLength; offset += chunk) {
+    size_t remaining = bodyLength - offset;
+    if (!sendAll(client, body + offset, remaining < chunk ? remaining : chunk)) {
+      return;
+    }
+
+    if (options->dripIntervalMs > 0 && offset + chunk < bodyLength) {
+      sleepMs(options->dripIntervalMs);
+    }
+  }
+}